@@ -9,7 +9,77 @@
 #include <math.h>		/* HUGE_VAL */
 #include <stdio.h>		/* sprintf() */
 #include <errno.h>		/* errno, ERANGE */
-#include <string.h>		/* memcpy() */
+#include <string.h>		/* memcpy(), memmove() */
+#ifdef _WIN32
+#include <io.h>			/* _write() */
+#else
+#include <unistd.h>		/* write(), sysconf() */
+#include <sys/uio.h>	/* writev(), struct iovec */
+#endif
+
+#ifndef LEPT_NO_THREADS
+#ifdef _WIN32
+#include <windows.h>	/* CreateThread() */
+#else
+#include <pthread.h>	/* pthread_create() */
+#endif
+#endif
+
+/*
+	LEPT_SIMD_LEVEL 可在编译选项中设为 0（标量）、1（SSE2）或 2（AVX2），固定使用该级别的内核，没有分派开销；
+	没设置时，编译所有可用的内核，第一次使用时按 CPU 选择。LEPT_NO_SIMD 等同于 LEPT_SIMD_LEVEL=0。
+*/
+#ifdef LEPT_NO_SIMD
+#undef LEPT_SIMD_LEVEL
+#define LEPT_SIMD_LEVEL 0
+#endif
+
+#if (!defined(LEPT_SIMD_LEVEL) || LEPT_SIMD_LEVEL >= 1) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define LEPT_SSE2
+#include <emmintrin.h>	/* SSE2 */
+#endif
+
+#if defined(LEPT_SSE2) && (!defined(LEPT_SIMD_LEVEL) || LEPT_SIMD_LEVEL >= 2) && \
+	(defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || (defined(_MSC_VER) && _MSC_VER >= 1700))
+#define LEPT_AVX2
+#include <immintrin.h>	/* AVX2 */
+#if defined(__GNUC__)
+#define LEPT_TARGET_AVX2	__attribute__((target("avx2")))  /* 只有这些函数使用 AVX2 指令，不需要 -mavx2 */
+#else
+#define LEPT_TARGET_AVX2
+#endif
+#endif
+
+#if defined(LEPT_SIMD_LEVEL) && ((LEPT_SIMD_LEVEL >= 1 && !defined(LEPT_SSE2)) || (LEPT_SIMD_LEVEL >= 2 && !defined(LEPT_AVX2)))
+#error "LEPT_SIMD_LEVEL is not supported by this compiler or target"
+#endif
+
+/*
+	会被多个线程同时用到的引用计数用原子操作增减，LEPT_REF_DEC() 返回减一后的值。
+	多个线程同时读写的指针用 LEPT_PTR_LOAD()、LEPT_PTR_STORE() 存取。
+	LEPT_NO_THREADS 时退化为普通的加减和读写。
+*/
+#if defined(LEPT_NO_THREADS)
+typedef size_t lept_refcount;
+#define LEPT_REF_INC(p)		(++*(p))
+#define LEPT_REF_DEC(p)		(--*(p))
+#define LEPT_PTR_LOAD(p)		(*(p))
+#define LEPT_PTR_STORE(p, v)	(*(p) = (v))
+#elif defined(_WIN32)
+typedef volatile LONG lept_refcount;
+#define LEPT_REF_INC(p)		InterlockedIncrement(p)
+#define LEPT_REF_DEC(p)		InterlockedDecrement(p)
+#define LEPT_PTR_LOAD(p)		InterlockedCompareExchangePointer((PVOID volatile*)(p), NULL, NULL)
+#define LEPT_PTR_STORE(p, v)	InterlockedExchangePointer((PVOID volatile*)(p), (PVOID)(v))
+#elif defined(__GNUC__)
+typedef size_t lept_refcount;
+#define LEPT_REF_INC(p)		__atomic_add_fetch(p, 1, __ATOMIC_RELAXED)
+#define LEPT_REF_DEC(p)		__atomic_sub_fetch(p, 1, __ATOMIC_ACQ_REL)
+#define LEPT_PTR_LOAD(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define LEPT_PTR_STORE(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+#else
+#error "atomic operations are not available for this compiler, define LEPT_NO_THREADS"
+#endif
 
 /*
 	使用 #ifndef X #define X ... #endif 方式的好处是，
@@ -24,22 +94,64 @@
 #define LEPT_PARSE_STRINGIFY_INIT_SIZE 256
 #endif
 
+#ifndef LEPT_STRINGIFY_BUFFER_SIZE
+#define LEPT_STRINGIFY_BUFFER_SIZE 4096		/* lept_stringify_to() 的默认缓冲区大小 */
+#endif
+
+#ifndef LEPT_WRITEV_BATCH
+#define LEPT_WRITEV_BATCH 64		/* lept_writev_fd() 每次 writev() 最多传入的片段数，不超过 IOV_MAX */
+#endif
+
+#ifndef LEPT_IOVEC_REF_MIN
+#define LEPT_IOVEC_REF_MIN 256		/* lept_stringify_iovec() 直接引用不需转义的片段的最小长度 */
+#endif
+
 #define EXPECT(c, ch)		do { assert(*c->json == (ch)); c->json++; } while (0)
 #define ISDIGIT(ch)			((ch) >= '0' && (ch) <= '9')  /* 加括号是防止取指针的值的时候发生错误 */
 #define ISDIGIT1TO9(ch)		((ch) >= '1' && (ch) <= '9')
 #define PUTC(c, ch)         do { *(char*)lept_context_push(c, sizeof(char)) = (ch); } while (0)
 #define PUTS(c, s, len)		do { memcpy(lept_context_push(c, len), s, len); } while (0)
 
+typedef struct lept_pretty lept_pretty;
+typedef struct lept_iov_list lept_iov_list;
+typedef struct lept_canon lept_canon;
+typedef struct lept_parallel lept_parallel;
+typedef struct lept_path_node lept_path_node;
+
 typedef struct {
 	const char* json;
+	int flags;		/* 解析选项 LEPT_PARSE_CHECK_UTF8 等 */
+	const lept_path_node* filter;	/* 解析容器时对应的路径结点，NULL 表示不过滤 */
+	int project;	/* 为 1 时只保留路径所指的值，否则去掉路径所指的值 */
+	const char* end;	/* 有路径过滤时为 json 的结尾 */
+	lept_shape* shapes;	/* 本次解析的形状树的空形状，第一次解析非空对象时建立 */
 	char* stack;	/* 利用堆栈制作的存放字符串等的缓冲区， 用 char* 是因为 char 是一个字节，这个堆栈不是普通堆栈，而是以字节储存的，每次可要求压入任意大小的数据 */
 	size_t size;	/* 栈 stack 的容量 */
 	size_t top;		/* 栈顶位置，因为会扩展 stack，所以 top 不以指针形式储存 */
+	lept_write_fn write;	/* 流式生成时不为 NULL，stack 满了就交给它，不再扩容 */
+	void* ud;
+	int error;		/* write 返回的错误，非 0 后不再调用 write */
+	const lept_pretty* pretty;	/* 带缩进输出时不为 NULL */
+	size_t depth;	/* 当前的嵌套层数 */
+	lept_iov_list* iov;	/* 生成 iovec 列表时不为 NULL */
+	lept_stringify_cache* cache;	/* 带缓存生成时不为 NULL */
+	lept_canon* canon;	/* 生成规范形式时不为 NULL */
+	const lept_parallel* parallel;	/* 并行生成时主线程的 context 不为 NULL */
 }lept_context;
 
+static void lept_context_flush(lept_context* c) {
+	if (c->top > 0 && c->error == 0) {
+		c->error = c->write(c->ud, c->stack, c->top);
+	}
+	c->top = 0;
+}
+
 static void* lept_context_push(lept_context* c, size_t size) {
 	void* ret;
 	assert(size > 0);
+	if (c->top + size >= c->size && c->write != NULL) {
+		lept_context_flush(c);
+	}
 	if (c->top + size >= c->size) {
 		if (c->size == 0) {
 			c->size = LEPT_PARSE_STACK_INIT_SIZE;
@@ -60,475 +172,3768 @@ static void* lept_context_pop(lept_context* c, size_t size) {
 	return c->stack + c->top;
 }
 
-static void lept_parse_whitespace(lept_context* c) {
-	const char* p = c->json;
-	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
-		p++;
+static void lept_iov_ref(lept_context* c, const char* s, size_t len);  /* 前向声明 */
+
+static void lept_context_write(lept_context* c, const char* s, size_t len) {
+	if (c->iov != NULL && len >= LEPT_IOVEC_REF_MIN) {
+		lept_iov_ref(c, s, len);  /* 直接引用，不复制 */
+		return;
+	}
+	/* 流式生成时，stack 放不下的较长数据不复制到 stack，直接交给 write */
+	if (c->write != NULL && c->top + len >= c->size) {
+		lept_context_flush(c);
+		if (len >= c->size / 2) {
+			if (c->error == 0) {
+				c->error = c->write(c->ud, s, len);
+			}
+			return;
+		}
+	}
+	if (len > 0) {
+		PUTS(c, s, len);
 	}
-	c->json = p;
 }
 
-static int lept_parse_literal(lept_context* c, lept_value* v, const char* literal, lept_type type) {
-	/*
-		解析字面量: "true", "false", "null", 将这三者情况合并
-	*/
-	EXPECT(c, literal[0]);
+/*
+	SIMD 内核与运行时分派：
+	每个内核都有标量、SSE2 和 AVX2 三个版本，较宽的版本处理完整块后把剩余部分交给较窄的版本，所以结果完全相同。
+	没有固定 LEPT_SIMD_LEVEL 时，每个级别有一张常量内核表，lept_kernels 原子地指向选中的表，
+	第一次调用时检测 CPU（可用环境变量 LEPT_SIMD 降级，值为 scalar、sse2 或 avx2）后设置。
+	几个线程同时初始化时写入的是同一个指针，lept_set_simd_level() 也只是换一个指针，表本身从不修改。
+	AVX-512 的机器使用 AVX2 内核：这些扫描多数在几十字节内结束，更宽的向量得不到好处。
+*/
+
+static size_t lept_scan_clean_scalar(const char* s, size_t len) {
+	/* 返回 s 开头不需要转义（不是 '"'、'\\' 或小于 0x20）的字节数 */
 	size_t i;
-	for (i = 0; literal[i + 1]; ++i) {
-		if (c->json[i] != literal[i + 1]) {
-			return LEPT_PARSE_INVALID_VALUE;
+	for (i = 0; i < len; ++i) {
+		unsigned char ch = (unsigned char)s[i];
+		if (ch == '"' || ch == '\\' || ch < 0x20) {
+			break;
 		}
 	}
-	c->json += i;
-	v->type = type;
-	return LEPT_PARSE_OK;
+	return i;
 }
 
-static int lept_parse_number(lept_context* c, lept_value* v) {
-	/*
-	char* end;
-	用 end 来接收数字后面的字符串，如果一开始就没有数字，直接返回 LEPT_PARSE_INVALID_VALUE
-	*/
+static size_t lept_scan_structural_scalar(const char* s, size_t len) {
+	/* 返回 s 开头不是 '"'、'['、']'、'{'、'}' 的字节数 */
+	size_t i;
+	for (i = 0; i < len; ++i) {
+		char ch = s[i];
+		if (ch == '"' || ch == '[' || ch == ']' || ch == '{' || ch == '}') {
+			break;
+		}
+	}
+	return i;
+}
 
-	const char* p = c->json;
-	/* 负号 */
-	if (*p == '-') {
+static const char* lept_skip_whitespace_scalar(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
 		++p;
 	}
+	return p;
+}
 
-	/* 整数 */
-	if (*p == '0') {
-		++p;
-	} else {
-		if (!ISDIGIT1TO9(*p)) {
-			return LEPT_PARSE_INVALID_VALUE;
-		}
-		for (++p; ISDIGIT1TO9(*p); ++p);
+/*
+	聚合计算：向量版本按 i % 4 分成四路累加，最后按 (0 + 2) + (1 + 3) 的顺序合并，
+	标量版本用同样的顺序，保证各个版本的求和结果完全相同
+*/
+
+static double lept_sum_doubles_tail(double s, const double* d, size_t i, size_t n) {
+	for (; i < n; ++i) {
+		s += d[i];
 	}
+	return s;
+}
 
-	/* 小数 */
-	if (*p == '.') {
-		++p;
-		if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
-		for (++p; ISDIGIT(*p); ++p);
+static double lept_minmax_doubles_tail(double r, const double* d, size_t i, size_t n, int max) {
+	for (; i < n; ++i) {
+		if (max ? d[i] > r : d[i] < r) {
+			r = d[i];
+		}
 	}
+	return r;
+}
 
-	/* 指数 */
-	if (*p == 'e' || *p == 'E') {
-		++p;
-		if (*p == '+' || *p == '-') ++p;
-		if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
-		for (++p; ISDIGIT(*p); ++p);
+#if !defined(LEPT_SIMD_LEVEL) || LEPT_SIMD_LEVEL == 0
+/* 扫描内核和 *_tail 也是较宽版本的尾部处理，总要编译；聚合内核只在会被分派到时编译 */
+static double lept_sum_doubles_scalar(const double* d, size_t n) {
+	size_t i;
+	double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+	for (i = 0; i + 4 <= n; i += 4) {
+		s0 += d[i];
+		s1 += d[i + 1];
+		s2 += d[i + 2];
+		s3 += d[i + 3];
 	}
+	return lept_sum_doubles_tail((s0 + s2) + (s1 + s3), d, i, n);
+}
 
-	/* 值过大 */
-	errno = 0;
-	v->u.n = strtod(c->json, NULL);
-	if (errno == ERANGE && (v->u.n == HUGE_VAL || v->u.n == -HUGE_VAL)) {
-		return LEPT_PARSE_NUMBER_TOO_BIG;
+static double lept_minmax_doubles_scalar(const double* d, size_t n, int max) {
+	return lept_minmax_doubles_tail(d[0], d, 1, n, max);
+}
+#endif
+
+#ifdef LEPT_SSE2
+static size_t lept_scan_clean_sse2(const char* s, size_t len) {
+	const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), control = _mm_set1_epi8(0x1F);
+	size_t i;
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash)),
+			_mm_cmpeq_epi8(_mm_max_epu8(x, control), control));  /* 无符号 x <= 0x1F */
+		unsigned mask = (unsigned)_mm_movemask_epi8(m);
+		if (mask != 0) {
+			while ((mask & 1) == 0) {
+				mask >>= 1;
+				++i;
+			}
+			return i;
+		}
 	}
+	return i + lept_scan_clean_scalar(s + i, len - i);
+}
 
-	c->json = p;
-	v->type = LEPT_NUMBER;
-	return LEPT_PARSE_OK;
+static size_t lept_scan_structural_sse2(const char* s, size_t len) {
+	/* '[' 和 '{'、']' 和 '}' 只差 0x20 这一位 */
+	const __m128i quote = _mm_set1_epi8('"'), open = _mm_set1_epi8('{'), close = _mm_set1_epi8('}'), bit = _mm_set1_epi8(0x20);
+	size_t i;
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+		__m128i y = _mm_or_si128(x, bit);
+		__m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_or_si128(_mm_cmpeq_epi8(y, open), _mm_cmpeq_epi8(y, close)));
+		unsigned mask = (unsigned)_mm_movemask_epi8(m);
+		if (mask != 0) {
+			while ((mask & 1) == 0) {
+				mask >>= 1;
+				++i;
+			}
+			return i;
+		}
+	}
+	return i + lept_scan_structural_scalar(s + i, len - i);
 }
 
-static const char* lept_parse_hex4(const char* p, unsigned* u) {
-	int i;
-	*u = 0;
-	for (i = 0; i < 4; ++i) {
-		char ch = *p++;
-		*u <<= 4;
-		if (ch >= '0' && ch <= '9')	*u |= ch - '0';
-		else if (ch >= 'A' && ch <= 'F')	*u |= ch - 'A' + 10;
-		else if (ch >= 'a' && ch <= 'f')	*u |= ch - 'a' + 10;
-		else return NULL;
+static const char* lept_skip_whitespace_sse2(const char* p, const char* end) {
+	for (; end - p >= 16; p += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)p);
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\r'))));
+		unsigned mask = ~(unsigned)_mm_movemask_epi8(m) & 0xFFFFu;  /* 不是空白的位置 */
+		if (mask != 0) {
+			while ((mask & 1) == 0) {
+				mask >>= 1;
+				++p;
+			}
+			return p;
+		}
 	}
-	return p;
+	return lept_skip_whitespace_scalar(p, end);
 }
 
-static void lept_encode_utf8(lept_context* c, unsigned u) {
-	/*
-		最终也是写进一个 char，为什么要做 x & 0xFF 这种操作呢？
-		这是因为 u 是 unsigned 类型，一些编译器可能会警告这个转型可能会截断数据。
-		但实际上，配合了范围的检测然后右移之后，可以保证写入的是 0~255 内的值。
-		为了避免一些编译器的警告误判，我们加上 x & 0xFF。
-		一般来说，编译器在优化之后，这与操作是会被消去的，不会影响性能。
-		其实超过 1 个字符输出时，可以只调用 1 次 lept_context_push()。
-		这里全用 PUTC() 只是为了代码看上去简单一点。
-	*/
-	if (u <= 0x7F) {
-		PUTC(c, u & 0xFF);
-	} else if (u <= 0x7FF) {
-		PUTC(c, 0xC0 | ((u >> 6) & 0xFF));
-		PUTC(c, 0x80 | (u & 0x3F));
-	} else if (u <= 0xFFFF) {
-		PUTC(c, 0xE0 | ((u >> 12) & 0xFF));
-		PUTC(c, 0x80 | ((u >> 6) & 0x3F));
-		PUTC(c, 0x80 | (u & 0x3F));
-	} else {
-		assert(u <= 0x10FFFF);
-		PUTC(c, 0xF0 | ((u >> 18) & 0xFF));
-		PUTC(c, 0x80 | ((u >> 12) & 0x3F));
-		PUTC(c, 0x80 | ((u >> 6) & 0x3F));
-		PUTC(c, 0x80 | (u & 0x3F));
+#if !defined(LEPT_SIMD_LEVEL) || LEPT_SIMD_LEVEL == 1
+static double lept_sum_doubles_sse2(const double* d, size_t n) {
+	__m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();  /* a0 是第 0、1 路，a1 是第 2、3 路 */
+	double lanes[2];
+	size_t i;
+	for (i = 0; i + 4 <= n; i += 4) {
+		a0 = _mm_add_pd(a0, _mm_loadu_pd(d + i));
+		a1 = _mm_add_pd(a1, _mm_loadu_pd(d + i + 2));
 	}
+	_mm_storeu_pd(lanes, _mm_add_pd(a0, a1));
+	return lept_sum_doubles_tail(lanes[0] + lanes[1], d, i, n);
 }
+#endif
 
-#define STRING_ERROR(ret) do { c->top = head; return ret; } while (0)
+static double lept_minmax_doubles_sse2(const double* d, size_t n, int max) {
+	__m128d m;
+	double lanes[2];
+	size_t i;
+	if (n < 2) {
+		return d[0];
+	}
+	m = _mm_loadu_pd(d);
+	for (i = 2; i + 2 <= n; i += 2) {
+		m = max ? _mm_max_pd(m, _mm_loadu_pd(d + i)) : _mm_min_pd(m, _mm_loadu_pd(d + i));
+	}
+	_mm_storeu_pd(lanes, m);
+	return lept_minmax_doubles_tail((max ? lanes[1] > lanes[0] : lanes[1] < lanes[0]) ? lanes[1] : lanes[0], d, i, n, max);
+}
+#endif
 
-/* 解析 JSON 字符串，把结果写入 str 和 len */
-/* str 指向 c->stack 中的元素，需要在 c->stack  */
-static int lept_parse_string_raw(lept_context* c, char** str, size_t* len) {
-	size_t head = c->top;
-	unsigned u, u2;
-	const char* p;
-	EXPECT(c, '\"');
-	p = c->json;
-	for (;;) {
-		char ch = *p++;
-		switch (ch) {
-			case '\"':
-				*len = c->top - head;
-				*str = lept_context_pop(c, *len);
-				c->json = p;
-				return LEPT_PARSE_OK;
-			case '\\':
-				switch (*p++) {
-					case '\\': PUTC(c, '\\'); break;
-					case '\"': PUTC(c, '\"'); break;
-					case '/':  PUTC(c, '/'); break;
-					case 'b':  PUTC(c, '\b'); break;
-					case 'f':  PUTC(c, '\f'); break;
-					case 'n':  PUTC(c, '\n'); break;
-					case 'r':  PUTC(c, '\r'); break;
-					case 't':  PUTC(c, '\t'); break;
-					case 'u':
-						if (!(p = lept_parse_hex4(p, &u))) {
-							STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
-						}
-						if (u >= 0xD800 && u <= 0xDBFF) {  /* surrogate pair */
-							/* 高代理项: 0xDB00 - 0xDBFF */
-							/* 低代理项: 0xDC00 - 0xDFFF */
-							if (*p++ != '\\') {
-								STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-							}
-							if (*p++ != 'u') {
-								STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-							}
-							if (!(p = lept_parse_hex4(p, &u2))) {
-								STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
-							}
-							if (u2 < 0xDC00 || u2 > 0xDFFF) {
-								STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-							}
-							/*
-								码点计算公式：
-								codepoint = 0x10000 + (H − 0xD800) × 0x400 + (L − 0xDC00)
-								H：高代理项	L：低代理项
-							*/
-							u = 0x10000 + (((u - 0xD800) << 10) | (u2 - 0xDC00));
-						}
-						lept_encode_utf8(c, u);
-						break;
-					default:
-						STRING_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE);
-				}
-				break;
-			case '\0':
-				STRING_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK);
-			default:
-				if ((unsigned char)ch < 0x20) {
-					STRING_ERROR(LEPT_PARSE_INVALID_STRING_CHAR);
-				}
-				PUTC(c, ch);
+#ifdef LEPT_AVX2
+LEPT_TARGET_AVX2 static size_t lept_scan_clean_avx2(const char* s, size_t len) {
+	const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\'), control = _mm256_set1_epi8(0x1F);
+	size_t i;
+	for (i = 0; i + 32 <= len; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(s + i));
+		__m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, quote), _mm256_cmpeq_epi8(x, backslash)),
+			_mm256_cmpeq_epi8(_mm256_max_epu8(x, control), control));
+		unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+		if (mask != 0) {
+			while ((mask & 1) == 0) {
+				mask >>= 1;
+				++i;
+			}
+			return i;
 		}
 	}
+	return i + lept_scan_clean_sse2(s + i, len - i);
 }
 
-static int lept_parse_string(lept_context* c, lept_value* v) {
-	int ret;
-	char* s;
-	size_t len;
-	if ((ret = lept_parse_string_raw(c, &s, &len)) == LEPT_PARSE_OK)
-		lept_set_string(v, s, len);
-	return ret;
+LEPT_TARGET_AVX2 static size_t lept_scan_structural_avx2(const char* s, size_t len) {
+	const __m256i quote = _mm256_set1_epi8('"'), open = _mm256_set1_epi8('{'), close = _mm256_set1_epi8('}'), bit = _mm256_set1_epi8(0x20);
+	size_t i;
+	for (i = 0; i + 32 <= len; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(s + i));
+		__m256i y = _mm256_or_si256(x, bit);
+		__m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(x, quote), _mm256_or_si256(_mm256_cmpeq_epi8(y, open), _mm256_cmpeq_epi8(y, close)));
+		unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+		if (mask != 0) {
+			while ((mask & 1) == 0) {
+				mask >>= 1;
+				++i;
+			}
+			return i;
+		}
+	}
+	return i + lept_scan_structural_sse2(s + i, len - i);
 }
 
-static int lept_parse_value(lept_context* c, lept_value* v);  /* 前向声明 */
+LEPT_TARGET_AVX2 static const char* lept_skip_whitespace_avx2(const char* p, const char* end) {
+	for (; end - p >= 32; p += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)p);
+		__m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t'))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r'))));
+		unsigned mask = ~(unsigned)_mm256_movemask_epi8(m);
+		if (mask != 0) {
+			while ((mask & 1) == 0) {
+				mask >>= 1;
+				++p;
+			}
+			return p;
+		}
+	}
+	return lept_skip_whitespace_sse2(p, end);
+}
 
-static int lept_parse_array(lept_context* c, lept_value* v) {
-	size_t i, size = 0;
-	int ret;
-	EXPECT(c, '[');
-	lept_parse_whitespace(c);
-	if (*c->json == ']') {
-		++c->json;
-		lept_set_array(v, 0);
-		return LEPT_PARSE_OK;
+LEPT_TARGET_AVX2 static double lept_sum_doubles_avx2(const double* d, size_t n) {
+	__m256d a = _mm256_setzero_pd();  /* 四路各占一个元素 */
+	double lanes[4];
+	size_t i;
+	for (i = 0; i + 4 <= n; i += 4) {
+		a = _mm256_add_pd(a, _mm256_loadu_pd(d + i));
 	}
+	_mm256_storeu_pd(lanes, a);
+	return lept_sum_doubles_tail((lanes[0] + lanes[2]) + (lanes[1] + lanes[3]), d, i, n);
+}
+
+LEPT_TARGET_AVX2 static double lept_minmax_doubles_avx2(const double* d, size_t n, int max) {
+	__m256d m;
+	double lanes[4];
+	size_t i;
+	if (n < 8) {
+		return lept_minmax_doubles_sse2(d, n, max);
+	}
+	m = _mm256_loadu_pd(d);
+	for (i = 4; i + 4 <= n; i += 4) {
+		m = max ? _mm256_max_pd(m, _mm256_loadu_pd(d + i)) : _mm256_min_pd(m, _mm256_loadu_pd(d + i));
+	}
+	_mm256_storeu_pd(lanes, m);
+	return lept_minmax_doubles_tail(lept_minmax_doubles_tail(lanes[0], lanes, 1, 4, max), d, i, n, max);
+}
+#endif
+
+#ifdef LEPT_SIMD_LEVEL
+
+#if LEPT_SIMD_LEVEL == 0
+#define LEPT_KERNEL(name)	lept_##name##_scalar
+#elif LEPT_SIMD_LEVEL == 1
+#define LEPT_KERNEL(name)	lept_##name##_sse2
+#else
+#define LEPT_KERNEL(name)	lept_##name##_avx2
+#endif
+
+int lept_get_simd_level(void) {
+	return LEPT_SIMD_LEVEL;
+}
+
+int lept_set_simd_level(int level) {
+	(void)level;
+	return LEPT_SIMD_LEVEL;  /* 编译时已固定 */
+}
+
+#else
+
+#define LEPT_KERNEL(name)	lept_get_kernels()->name
+
+typedef struct {
+	int level;
+	size_t (*scan_clean)(const char* s, size_t len);
+	size_t (*scan_structural)(const char* s, size_t len);
+	const char* (*skip_whitespace)(const char* p, const char* end);
+	double (*sum_doubles)(const double* d, size_t n);
+	double (*minmax_doubles)(const double* d, size_t n, int max);
+} lept_kernel_table;
+
+static const lept_kernel_table lept_kernels_scalar = {
+	LEPT_SIMD_SCALAR, lept_scan_clean_scalar, lept_scan_structural_scalar, lept_skip_whitespace_scalar, lept_sum_doubles_scalar, lept_minmax_doubles_scalar
+};
+#ifdef LEPT_SSE2
+static const lept_kernel_table lept_kernels_sse2 = {
+	LEPT_SIMD_SSE2, lept_scan_clean_sse2, lept_scan_structural_sse2, lept_skip_whitespace_sse2, lept_sum_doubles_sse2, lept_minmax_doubles_sse2
+};
+#endif
+#ifdef LEPT_AVX2
+static const lept_kernel_table lept_kernels_avx2 = {
+	LEPT_SIMD_AVX2, lept_scan_clean_avx2, lept_scan_structural_avx2, lept_skip_whitespace_avx2, lept_sum_doubles_avx2, lept_minmax_doubles_avx2
+};
+#endif
+
+static const lept_kernel_table* lept_kernels = NULL;	/* 尚未选择时为 NULL */
+
+static int lept_cpu_simd_level(void) {
+	/* CPU 和操作系统都支持的最高级别 */
+#if defined(LEPT_AVX2) && defined(_MSC_VER)
+	int r[4];
+	__cpuid(r, 0);
+	if (r[0] >= 7) {
+		__cpuid(r, 1);
+		/* OSXSAVE 和 AVX，且操作系统会保存 YMM 寄存器 */
+		if ((r[2] & (1 << 27)) && (r[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6) {
+			__cpuidex(r, 7, 0);
+			if (r[1] & (1 << 5)) {
+				return LEPT_SIMD_AVX2;
+			}
+		}
+	}
+#elif defined(LEPT_AVX2)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return LEPT_SIMD_AVX2;
+	}
+#endif
+#ifdef LEPT_SSE2
+	return LEPT_SIMD_SSE2;
+#else
+	return LEPT_SIMD_SCALAR;
+#endif
+}
+
+static const lept_kernel_table* lept_select_kernels(int level) {
+#ifdef LEPT_AVX2
+	if (level >= LEPT_SIMD_AVX2) {
+		return &lept_kernels_avx2;
+	}
+#endif
+#ifdef LEPT_SSE2
+	if (level >= LEPT_SIMD_SSE2) {
+		return &lept_kernels_sse2;
+	}
+#endif
+	(void)level;
+	return &lept_kernels_scalar;
+}
+
+static const lept_kernel_table* lept_init_kernels(void) {
+	const lept_kernel_table* k;
+	int level = lept_cpu_simd_level();
+	const char* env = getenv("LEPT_SIMD");
+	if (env != NULL) {
+		if (strcmp(env, "scalar") == 0) {
+			level = LEPT_SIMD_SCALAR;
+		} else if (strcmp(env, "sse2") == 0 && level > LEPT_SIMD_SSE2) {
+			level = LEPT_SIMD_SSE2;
+		}
+	}
+	k = lept_select_kernels(level);
+	LEPT_PTR_STORE(&lept_kernels, k);
+	return k;
+}
+
+static const lept_kernel_table* lept_get_kernels(void) {
+	const lept_kernel_table* k = LEPT_PTR_LOAD(&lept_kernels);
+	return k != NULL ? k : lept_init_kernels();
+}
+
+int lept_get_simd_level(void) {
+	return lept_get_kernels()->level;
+}
+
+int lept_set_simd_level(int level) {
+	const lept_kernel_table* k;
+	if (level < 0) {
+		k = lept_init_kernels();
+	} else {
+		int max = lept_cpu_simd_level();
+		k = lept_select_kernels(level < max ? level : max);
+		LEPT_PTR_STORE(&lept_kernels, k);
+	}
+	return k->level;
+}
+
+#endif
+
+static size_t lept_scan_clean(const char* s, size_t len) {
+	return LEPT_KERNEL(scan_clean)(s, len);
+}
+
+static size_t lept_scan_structural(const char* s, size_t len) {
+	return LEPT_KERNEL(scan_structural)(s, len);
+}
+
+static const char* lept_skip_whitespace(const char* p, const char* end) {
+	return LEPT_KERNEL(skip_whitespace)(p, end);
+}
+
+static double lept_sum_doubles(const double* d, size_t n) {
+	return LEPT_KERNEL(sum_doubles)(d, n);
+}
+
+static double lept_minmax_doubles(const double* d, size_t n, int max) {
+	return LEPT_KERNEL(minmax_doubles)(d, n, max);
+}
+
+/*
+	对象形状（hidden class）：
+	形状是从空形状出发、按顺序逐个添加键得到的一棵转移树。每个形状记录自己的全部键，
+	键集合和顺序相同的对象指向同一个形状，只需各自保存一个值数组。
+	添加一个键就是沿转移边走到子形状，子形状不存在时才新建，所以同类对象反复出现时，
+	既不需要为键 malloc，也不需要复制键。
+
+	每次解析建立自己的一棵形状树，只有解析过程会新建形状，解析结束后树就不再修改：
+	对象新增键时只沿已有的转移边走，没有这条边就退回 lept_member 布局。
+	所以多个线程可以同时解析各自的文档，也可以同时读同一个文档。
+	整棵树按引用计数一起释放，计数是指向树中形状的对象数。对象复制、移动到别的文档后
+	仍然指向原来的树，各线程释放各自的文档时会同时修改计数，所以计数用原子操作增减。
+
+	一个形状的转移边达到 LEPT_SHAPE_MAX_CHILDREN 条后不再新建子形状，
+	键各不相同的对象（例如以 id 为键的映射）很快就退回 lept_member 布局，树不会无限增长。
+
+	为了不让长链上每个形状都各存一份键数组，沿“主干”扩展出的形状共用同一个 lept_key_list，
+	只有出现分叉时才复制一份。键字符串由引入它的形状持有，随整棵树一起释放。
+*/
+
+#ifndef LEPT_SHAPE_MAX_KEYS
+#define LEPT_SHAPE_MAX_KEYS 32		/* 键数超过此值的对象使用 lept_member 布局，设为 0 可关闭形状 */
+#endif
+
+#ifndef LEPT_SHAPE_LINEAR_KEYS
+#define LEPT_SHAPE_LINEAR_KEYS 8	/* 键数不超过此值的形状直接线性查找，否则使用哈希表 */
+#endif
+
+#ifndef LEPT_SHAPE_MAX_CHILDREN
+#define LEPT_SHAPE_MAX_CHILDREN 16	/* 每个形状最多的转移边数 */
+#endif
+
+#define LEPT_FLAG_SHAPED 0x1u		/* object 使用形状布局 u.so */
+#define IS_SHAPED(v)		(((v)->flags & LEPT_FLAG_SHAPED) != 0)
+
+typedef struct {
+	const char* k; size_t klen;  /* 键字符串由引入它的形状持有 */
+	unsigned hash;
+	int clean;		/* 键不含需要转义的字符，生成 JSON 时可以直接复制 */
+}lept_shape_key;
+
+typedef struct {
+	lept_shape_key* keys;
+	size_t size;		/* 已被某个形状使用的键数，等于 size 的形状可以直接在末尾扩展 */
+	size_t capacity;
+	size_t refcount;	/* 共用此数组的形状数 */
+}lept_key_list;
+
+typedef struct lept_shape_tree lept_shape_tree;
+
+struct lept_shape {
+	lept_shape_tree* tree;	/* 所属的形状树 */
+	lept_shape* parent;		/* 去掉最后一个键得到的形状 */
+	lept_shape** children;	/* 转移边的开放寻址哈希表，按新增键的哈希值存放 */
+	size_t nchildren;
+	size_t cmask;			/* children 的容量减 1 */
+	lept_key_list* list;	/* list->keys[0, size) 是本形状的键 */
+	size_t size;
+	size_t* table;			/* 键的开放寻址哈希表，存 index + 1，键数超过 LEPT_SHAPE_LINEAR_KEYS 时建立形状就生成 */
+	size_t mask;
+};
+
+struct lept_shape_tree {
+	lept_shape root;		/* 空形状 */
+	lept_refcount refcount;	/* 指向树中形状的对象数，解析期间解析过程也持有一个 */
+};
+
+static unsigned lept_hash_key(const char* key, size_t klen) {
+	/* FNV-1a，只取低 32 位，保证不同平台上结果一致 */
+	unsigned h = 2166136261u;
+	size_t i;
+	for (i = 0; i < klen; ++i) {
+		h ^= (unsigned char)key[i];
+		h = (h * 16777619u) & 0xFFFFFFFFu;
+	}
+	return h;
+}
+
+static int lept_shape_key_equal(const lept_shape_key* k, const char* key, size_t klen, unsigned hash) {
+	/* 空键的字符串可能是 NULL，不能交给 memcmp() */
+	return k->hash == hash && k->klen == klen && (klen == 0 || memcmp(k->k, key, klen) == 0);
+}
+
+static lept_shape* lept_shape_tree_new(void) {
+	/* 新建只有空形状的树，返回空形状，已计入调用者的一个引用 */
+	lept_shape_tree* t = (lept_shape_tree*)malloc(sizeof(lept_shape_tree));
+	lept_shape* s = &t->root;
+	s->tree = t;
+	s->parent = NULL;
+	s->children = NULL;
+	s->nchildren = s->cmask = 0;
+	s->list = NULL;
+	s->size = 0;
+	s->table = NULL;
+	s->mask = 0;
+	t->refcount = 1;
+	return s;
+}
+
+static void lept_shape_free(lept_shape* s) {
+	/* 释放 s 的子形状及 s 持有的内存，递归深度不超过 LEPT_SHAPE_MAX_KEYS */
+	size_t i;
+	if (s->nchildren > 0) {
+		for (i = 0; i <= s->cmask; ++i) {
+			if (s->children[i] != NULL) {
+				lept_shape_free(s->children[i]);
+				free(s->children[i]);
+			}
+		}
+		free(s->children);
+	}
+	free(s->table);
+	if (s->size > 0) {
+		free((char*)s->list->keys[s->size - 1].k);
+		if (--s->list->refcount == 0) {
+			free(s->list->keys);
+			free(s->list);
+		}
+	}
+}
+
+static lept_shape* lept_shape_retain(lept_shape* s) {
+	LEPT_REF_INC(&s->tree->refcount);
+	return s;
+}
+
+static void lept_shape_release(lept_shape* s) {
+	lept_shape_tree* t = s->tree;
+	if (LEPT_REF_DEC(&t->refcount) == 0) {
+		lept_shape_free(&t->root);
+		free(t);
+	}
+}
+
+static lept_shape* lept_shape_child(const lept_shape* s, const char* key, size_t klen, unsigned hash) {
+	/* 沿已有的转移边走，不修改形状树，没有这条边时返回 NULL */
+	size_t i;
+	if (s->nchildren == 0) {
+		return NULL;
+	}
+	for (i = hash & s->cmask; s->children[i] != NULL; i = (i + 1) & s->cmask) {
+		if (lept_shape_key_equal(&s->children[i]->list->keys[s->size], key, klen, hash)) {
+			return s->children[i];
+		}
+	}
+	return NULL;
+}
+
+static void lept_shape_link(lept_shape* s, lept_shape* c) {
+	/* 把子形状 c 加入 s 的转移边，装填率保持在一半以下 */
+	size_t i, j, n = s->nchildren > 0 ? s->cmask + 1 : 0;
+	if (2 * (s->nchildren + 1) > n) {
+		lept_shape** old = s->children;
+		size_t mask = n == 0 ? 3 : 2 * n - 1;
+		s->children = (lept_shape**)calloc(mask + 1, sizeof(lept_shape*));
+		for (i = 0; i < n; ++i) {
+			if (old[i] != NULL) {
+				for (j = old[i]->list->keys[s->size].hash & mask; s->children[j] != NULL; j = (j + 1) & mask);
+				s->children[j] = old[i];
+			}
+		}
+		free(old);
+		s->cmask = mask;
+	}
+	for (j = c->list->keys[s->size].hash & s->cmask; s->children[j] != NULL; j = (j + 1) & s->cmask);
+	s->children[j] = c;
+	++s->nchildren;
+}
+
+static void lept_shape_build_table(lept_shape* s) {
+	size_t i, j, n = 16;
+	while (n < 2 * s->size) {
+		n *= 2;
+	}
+	s->mask = n - 1;
+	s->table = (size_t*)calloc(n, sizeof(size_t));
+	for (i = 0; i < s->size; ++i) {
+		const lept_shape_key* k = &s->list->keys[i];
+		for (j = k->hash & s->mask; s->table[j] != 0; j = (j + 1) & s->mask) {
+			if (lept_shape_key_equal(&s->list->keys[s->table[j] - 1], k->k, k->klen, k->hash)) {
+				break;  /* 重复的键只保留第一个，与线性查找的结果一致 */
+			}
+		}
+		if (s->table[j] == 0) {
+			s->table[j] = i + 1;
+		}
+	}
+}
+
+static lept_shape* lept_shape_add(lept_shape* s, const char* key, size_t klen, unsigned hash) {
+	/*
+		新建 s 添加 key 后的形状并加入 s 的转移边，调用者需确认这条边不存在。
+		会修改形状树，只能在建立这棵树的解析过程中调用。
+		s 的键数或转移边数已达上限时返回 NULL
+	*/
+	lept_shape* c;
+	lept_key_list* list;
+	char* k;
+	if (s->size == LEPT_SHAPE_MAX_KEYS || s->nchildren == LEPT_SHAPE_MAX_CHILDREN) {
+		return NULL;
+	}
+	if (s->list != NULL && s->list->size == s->size) {
+		list = s->list;
+		++list->refcount;
+	} else {
+		list = (lept_key_list*)malloc(sizeof(lept_key_list));
+		list->capacity = s->size < 4 ? 4 : s->size * 2;
+		list->keys = (lept_shape_key*)malloc(list->capacity * sizeof(lept_shape_key));
+		if (s->size > 0) {
+			memcpy(list->keys, s->list->keys, s->size * sizeof(lept_shape_key));
+		}
+		list->size = s->size;
+		list->refcount = 1;
+	}
+	if (list->size == list->capacity) {
+		list->capacity *= 2;
+		list->keys = (lept_shape_key*)realloc(list->keys, list->capacity * sizeof(lept_shape_key));
+	}
+	k = (char*)malloc(klen + 1);
+	if (klen > 0) {
+		memcpy(k, key, klen);
+	}
+	k[klen] = '\0';
+	list->keys[list->size].k = k;
+	list->keys[list->size].klen = klen;
+	list->keys[list->size].hash = hash;
+	list->keys[list->size].clean = lept_scan_clean(k, klen) == klen;  /* 每个新形状只检查一次 */
+	++list->size;
+
+	c = (lept_shape*)malloc(sizeof(lept_shape));
+	c->tree = s->tree;
+	c->parent = s;
+	c->children = NULL;
+	c->nchildren = c->cmask = 0;
+	c->list = list;
+	c->size = s->size + 1;
+	c->table = NULL;
+	c->mask = 0;
+	if (c->size > LEPT_SHAPE_LINEAR_KEYS) {
+		lept_shape_build_table(c);  /* 建树时就生成，查找时不修改形状 */
+	}
+	lept_shape_link(s, c);
+	return c;
+}
+
+static size_t lept_shape_find(const lept_shape* s, const char* key, size_t klen, unsigned hash) {
+	const lept_shape_key* keys = s->list != NULL ? s->list->keys : NULL;
+	size_t i;
+	if (s->table == NULL) {
+		for (i = 0; i < s->size; ++i) {
+			if (lept_shape_key_equal(&keys[i], key, klen, hash)) {
+				return i;
+			}
+		}
+		return LEPT_KEY_NOT_EXIST;
+	}
+	for (i = hash & s->mask; s->table[i] != 0; i = (i + 1) & s->mask) {
+		if (lept_shape_key_equal(&keys[s->table[i] - 1], key, klen, hash)) {
+			return s->table[i] - 1;
+		}
+	}
+	return LEPT_KEY_NOT_EXIST;
+}
+
+static void lept_set_shaped_object(lept_value* v, lept_shape* shape, size_t capacity) {
+	/* 创建使用形状布局的对象，接管调用者对 shape 所在树的引用，值数组由调用者填写 */
+	assert(capacity >= shape->size);
+	lept_free(v);
+	v->type = LEPT_OBJECT;
+	v->flags = LEPT_FLAG_SHAPED;
+	v->u.so.shape = shape;
+	v->u.so.capacity = capacity;
+	v->u.so.v = capacity > 0 ? (lept_value*)malloc(capacity * sizeof(lept_value)) : NULL;
+}
+
+
+/*
+	紧凑数组：元素全是数字的数组直接存 double[]，省去每个元素 lept_value 的类型字段和填充，
+	也便于向量化地做聚合计算。紧凑存储没有元素的 lept_value，只读的函数按值取出数字，
+	需要元素指针时由调用者用 lept_unpack_array() 显式转回普通存储。
+*/
+
+#ifndef LEPT_PACKED_ARRAY_MIN
+#define LEPT_PACKED_ARRAY_MIN 16	/* LEPT_PARSE_PACK_ARRAYS 解析时至少有这么多个数字才使用紧凑存储，设为 0 可关闭 */
+#endif
+
+#define LEPT_FLAG_PACKED 0x2u		/* array 使用紧凑存储 u.pa */
+#define IS_PACKED(v)		(((v)->flags & LEPT_FLAG_PACKED) != 0)
+
+static void lept_set_packed_array(lept_value* v, size_t capacity) {
+	lept_free(v);
+	v->type = LEPT_ARRAY;
+	v->flags = LEPT_FLAG_PACKED;
+	v->u.pa.size = 0;
+	v->u.pa.capacity = capacity;
+	v->u.pa.d = capacity > 0 ? (double*)malloc(capacity * sizeof(double)) : NULL;
+}
+
+/*
+	分块数组：元素放在大小为 LEPT_ARRAY_BLOCK_SIZE 的块中，u.sa.b 是块指针数组。
+	除最后一块外每块都是满的，所以第 i 个元素就在 b[i / BLOCK][i % BLOCK]。
+	扩容只需分配新块、偶尔扩大块指针数组，已有元素从不搬动。
+*/
+
+#ifndef LEPT_ARRAY_BLOCK_SHIFT
+#define LEPT_ARRAY_BLOCK_SHIFT 8	/* 每块 256 个元素 */
+#endif
+
+#define LEPT_ARRAY_BLOCK_SIZE	((size_t)1 << LEPT_ARRAY_BLOCK_SHIFT)
+#define LEPT_ARRAY_BLOCK_MASK	(LEPT_ARRAY_BLOCK_SIZE - 1)
+#define LEPT_FLAG_SEGMENTED		0x4u	/* array 使用分块存储 u.sa */
+#define IS_SEGMENTED(v)			(((v)->flags & LEPT_FLAG_SEGMENTED) != 0)
+
+static lept_value* lept_array_at(const lept_value* v, size_t index) {
+	/* 普通存储和分块存储的元素地址，紧凑存储没有 lept_value，不能用 */
+	assert(!IS_PACKED(v));
+	if (IS_SEGMENTED(v)) {
+		return &v->u.sa.b[index >> LEPT_ARRAY_BLOCK_SHIFT][index & LEPT_ARRAY_BLOCK_MASK];
+	}
+	return &v->u.a.e[index];
+}
+
+static size_t lept_index_capacity(size_t nblocks) {
+	/* 块指针数组的容量总是不小于块数的 2 的幂 */
+	size_t n = 1;
+	while (n < nblocks) {
+		n <<= 1;
+	}
+	return nblocks == 0 ? 0 : n;
+}
+
+static void lept_reserve_segments(lept_value* v, size_t capacity) {
+	size_t nblocks = v->u.sa.capacity >> LEPT_ARRAY_BLOCK_SHIFT;
+	size_t need = (capacity + LEPT_ARRAY_BLOCK_MASK) >> LEPT_ARRAY_BLOCK_SHIFT;
+	if (need <= nblocks) {
+		return;
+	}
+	if (lept_index_capacity(need) > lept_index_capacity(nblocks)) {
+		v->u.sa.b = (lept_value**)realloc(v->u.sa.b, lept_index_capacity(need) * sizeof(lept_value*));
+	}
+	for (; nblocks < need; ++nblocks) {
+		v->u.sa.b[nblocks] = (lept_value*)malloc(LEPT_ARRAY_BLOCK_SIZE * sizeof(lept_value));
+	}
+	v->u.sa.capacity = nblocks << LEPT_ARRAY_BLOCK_SHIFT;
+}
+
+static void lept_shrink_segments(lept_value* v) {
+	size_t nblocks = v->u.sa.capacity >> LEPT_ARRAY_BLOCK_SHIFT;
+	size_t need = (v->u.sa.size + LEPT_ARRAY_BLOCK_MASK) >> LEPT_ARRAY_BLOCK_SHIFT;
+	if (need == nblocks) {
+		return;
+	}
+	while (nblocks > need) {
+		free(v->u.sa.b[--nblocks]);
+	}
+	if (need == 0) {
+		free(v->u.sa.b);
+		v->u.sa.b = NULL;
+	} else {
+		v->u.sa.b = (lept_value**)realloc(v->u.sa.b, lept_index_capacity(need) * sizeof(lept_value*));
+	}
+	v->u.sa.capacity = need << LEPT_ARRAY_BLOCK_SHIFT;
+}
+
+static void lept_move_segments(lept_value* v, size_t dst, size_t src, size_t count) {
+	/* 分块数组内的 memmove()，按块边界切成若干段，重叠时从合适的方向搬 */
+	size_t n;
+	if (dst < src) {
+		while (count > 0) {
+			n = count;
+			if (n > LEPT_ARRAY_BLOCK_SIZE - (dst & LEPT_ARRAY_BLOCK_MASK)) n = LEPT_ARRAY_BLOCK_SIZE - (dst & LEPT_ARRAY_BLOCK_MASK);
+			if (n > LEPT_ARRAY_BLOCK_SIZE - (src & LEPT_ARRAY_BLOCK_MASK)) n = LEPT_ARRAY_BLOCK_SIZE - (src & LEPT_ARRAY_BLOCK_MASK);
+			memmove(lept_array_at(v, dst), lept_array_at(v, src), n * sizeof(lept_value));
+			dst += n;
+			src += n;
+			count -= n;
+		}
+	} else if (dst > src) {
+		dst += count;
+		src += count;
+		while (count > 0) {
+			n = count;
+			if (n > ((dst - 1) & LEPT_ARRAY_BLOCK_MASK) + 1) n = ((dst - 1) & LEPT_ARRAY_BLOCK_MASK) + 1;
+			if (n > ((src - 1) & LEPT_ARRAY_BLOCK_MASK) + 1) n = ((src - 1) & LEPT_ARRAY_BLOCK_MASK) + 1;
+			dst -= n;
+			src -= n;
+			memmove(lept_array_at(v, dst), lept_array_at(v, src), n * sizeof(lept_value));
+			count -= n;
+		}
+	}
+}
+
+static int lept_array_number(const lept_value* v, size_t index, double* n) {
+	/* 不论哪种存储，取出第 index 个元素的数值，不是数字时返回 0 */
+	if (IS_PACKED(v)) {
+		*n = v->u.pa.d[index];
+		return 1;
+	}
+	if (lept_array_at(v, index)->type != LEPT_NUMBER) {
+		return 0;
+	}
+	*n = lept_array_at(v, index)->u.n;
+	return 1;
+}
+
+static void lept_parse_whitespace(lept_context* c) {
+	const char* p = c->json;
+	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+		p++;
+	}
+	c->json = p;
+}
+
+static int lept_parse_literal(lept_context* c, lept_value* v, const char* literal, lept_type type) {
+	/*
+		解析字面量: "true", "false", "null", 将这三者情况合并
+	*/
+	EXPECT(c, literal[0]);
+	size_t i;
+	for (i = 0; literal[i + 1]; ++i) {
+		if (c->json[i] != literal[i + 1]) {
+			c->json += i;  /* 出错位置 */
+			return LEPT_PARSE_INVALID_VALUE;
+		}
+	}
+	c->json += i;
+	v->type = type;
+	return LEPT_PARSE_OK;
+}
+
+static int lept_parse_number(lept_context* c, lept_value* v) {
+	/*
+	char* end;
+	用 end 来接收数字后面的字符串，如果一开始就没有数字，直接返回 LEPT_PARSE_INVALID_VALUE
+	*/
+
+	const char* p = c->json;
+	char* end;
+	/* 负号 */
+	if (*p == '-') {
+		++p;
+	}
+
+	/* 整数 */
+	if (*p == '0') {
+		++p;
+	} else {
+		if (!ISDIGIT1TO9(*p)) {
+			return LEPT_PARSE_INVALID_VALUE;
+		}
+		for (++p; ISDIGIT(*p); ++p);
+	}
+
+	/* 小数 */
+	if (*p == '.') {
+		++p;
+		if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
+		for (++p; ISDIGIT(*p); ++p);
+	}
+
+	/* 指数 */
+	if (*p == 'e' || *p == 'E') {
+		++p;
+		if (*p == '+' || *p == '-') ++p;
+		if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
+		for (++p; ISDIGIT(*p); ++p);
+	}
+
+	/* 值过大 */
+	errno = 0;
+	v->u.n = strtod(c->json, &end);
+	if (end != p) {
+		/*
+			strtod() 比语法多读了：只会发生在 "0"、"-0" 后面紧跟数字或 x（十六进制）时，
+			这些字符属于下一个记号，只转换 [c->json, p)。
+		*/
+		char buffer[3];
+		size_t len = (size_t)(p - c->json);
+		assert(len < sizeof(buffer));
+		memcpy(buffer, c->json, len);
+		buffer[len] = '\0';
+		errno = 0;
+		v->u.n = strtod(buffer, NULL);
+	}
+	if (errno == ERANGE && (v->u.n == HUGE_VAL || v->u.n == -HUGE_VAL)) {
+		return LEPT_PARSE_NUMBER_TOO_BIG;
+	}
+
+	c->json = p;
+	v->type = LEPT_NUMBER;
+	return LEPT_PARSE_OK;
+}
+
+static const char* lept_parse_hex4(const char* p, unsigned* u) {
+	int i;
+	*u = 0;
+	for (i = 0; i < 4; ++i) {
+		char ch = *p++;
+		*u <<= 4;
+		if (ch >= '0' && ch <= '9')	*u |= ch - '0';
+		else if (ch >= 'A' && ch <= 'F')	*u |= ch - 'A' + 10;
+		else if (ch >= 'a' && ch <= 'f')	*u |= ch - 'a' + 10;
+		else return NULL;
+	}
+	return p;
+}
+
+static void lept_encode_utf8(lept_context* c, unsigned u) {
+	/*
+		最终也是写进一个 char，为什么要做 x & 0xFF 这种操作呢？
+		这是因为 u 是 unsigned 类型，一些编译器可能会警告这个转型可能会截断数据。
+		但实际上，配合了范围的检测然后右移之后，可以保证写入的是 0~255 内的值。
+		为了避免一些编译器的警告误判，我们加上 x & 0xFF。
+		一般来说，编译器在优化之后，这与操作是会被消去的，不会影响性能。
+		其实超过 1 个字符输出时，可以只调用 1 次 lept_context_push()。
+		这里全用 PUTC() 只是为了代码看上去简单一点。
+	*/
+	if (u <= 0x7F) {
+		PUTC(c, u & 0xFF);
+	} else if (u <= 0x7FF) {
+		PUTC(c, 0xC0 | ((u >> 6) & 0xFF));
+		PUTC(c, 0x80 | (u & 0x3F));
+	} else if (u <= 0xFFFF) {
+		PUTC(c, 0xE0 | ((u >> 12) & 0xFF));
+		PUTC(c, 0x80 | ((u >> 6) & 0x3F));
+		PUTC(c, 0x80 | (u & 0x3F));
+	} else {
+		assert(u <= 0x10FFFF);
+		PUTC(c, 0xF0 | ((u >> 18) & 0xFF));
+		PUTC(c, 0x80 | ((u >> 12) & 0x3F));
+		PUTC(c, 0x80 | ((u >> 6) & 0x3F));
+		PUTC(c, 0x80 | (u & 0x3F));
+	}
+}
+
+#define STRING_ERROR(ret) do { c->json = p - 1; c->top = head; return ret; } while (0)  /* p 已越过出错的字符 */
+
+/* 解析 JSON 字符串，把结果写入 str 和 len */
+/* str 指向 c->stack 中的元素，需要在 c->stack  */
+/*
+	字符串是否需要转义：解析时没有遇到转义序列的字符串一定不含 '"'、'\\' 和控制字符，
+	生成 JSON 时可以整段复制。lept_set_string() 设置时就扫描一遍。
+	标志在建立字符串时确定，生成 JSON 时只读，多个线程可以同时生成同一个文档。
+*/
+#define LEPT_FLAG_CLEAN		0x8u	/* string 不需要转义 */
+
+static void lept_set_string_flags(lept_value* v, const char* s, size_t len, unsigned flags);  /* 前向声明 */
+
+static const char* lept_parse_utf8(const char* p) {
+	/*
+		p 指向一个 >= 0x80 的首字节，是合法的 UTF-8 序列时返回下一个字符的位置，否则返回 NULL。
+		按 Unicode 标准表 3-7 检查每个字节的范围，这样过长形式、代理项（U+D800~U+DFFF）、
+		超过 U+10FFFF 的码点和截断的序列都不合法。'\0' 不是续字节，所以不会越过字符串末尾。
+	*/
+	const unsigned char* s = (const unsigned char*)p;
+	unsigned char lo = 0x80, hi = 0xBF;  /* 第二个字节的范围 */
+	int i, n;
+	if (s[0] >= 0xC2 && s[0] <= 0xDF) {
+		n = 1;
+	} else if (s[0] >= 0xE0 && s[0] <= 0xEF) {
+		n = 2;
+		if (s[0] == 0xE0) lo = 0xA0;		/* 过长形式 */
+		else if (s[0] == 0xED) hi = 0x9F;	/* 代理项 */
+	} else if (s[0] >= 0xF0 && s[0] <= 0xF4) {
+		n = 3;
+		if (s[0] == 0xF0) lo = 0x90;		/* 过长形式 */
+		else if (s[0] == 0xF4) hi = 0x8F;	/* 超过 U+10FFFF */
+	} else {
+		return NULL;  /* 续字节、0xC0、0xC1、0xF5~0xFF 不能作为首字节 */
+	}
+	if (s[1] < lo || s[1] > hi) {
+		return NULL;
+	}
+	for (i = 2; i <= n; ++i) {
+		if (s[i] < 0x80 || s[i] > 0xBF) {
+			return NULL;
+		}
+	}
+	return p + n + 1;
+}
+
+static int lept_parse_string_raw(lept_context* c, char** str, size_t* len, int* clean) {
+	size_t head = c->top;
+	unsigned u, u2;
+	const char* p;
+	const char* q;
+	EXPECT(c, '\"');
+	p = c->json;
+	*clean = 1;
+	for (;;) {
+		char ch = *p++;
+		switch (ch) {
+			case '\"':
+				*len = c->top - head;
+				*str = lept_context_pop(c, *len);
+				c->json = p;
+				return LEPT_PARSE_OK;
+			case '\\':
+				*clean = 0;
+				switch (*p++) {
+					case '\\': PUTC(c, '\\'); break;
+					case '\"': PUTC(c, '\"'); break;
+					case '/':  PUTC(c, '/'); break;
+					case 'b':  PUTC(c, '\b'); break;
+					case 'f':  PUTC(c, '\f'); break;
+					case 'n':  PUTC(c, '\n'); break;
+					case 'r':  PUTC(c, '\r'); break;
+					case 't':  PUTC(c, '\t'); break;
+					case 'u':
+						if (!(q = lept_parse_hex4(p, &u))) {
+							STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);  /* 指向 'u' */
+						}
+						p = q;
+						if (u >= 0xD800 && u <= 0xDBFF) {  /* surrogate pair */
+							/* 高代理项: 0xDB00 - 0xDBFF */
+							/* 低代理项: 0xDC00 - 0xDFFF */
+							if (*p++ != '\\') {
+								STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+							}
+							if (*p++ != 'u') {
+								STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+							}
+							if (!(q = lept_parse_hex4(p, &u2))) {
+								STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
+							}
+							p = q;
+							if (u2 < 0xDC00 || u2 > 0xDFFF) {
+								STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+							}
+							/*
+								码点计算公式：
+								codepoint = 0x10000 + (H − 0xD800) × 0x400 + (L − 0xDC00)
+								H：高代理项	L：低代理项
+							*/
+							u = 0x10000 + (((u - 0xD800) << 10) | (u2 - 0xDC00));
+						} else if (u >= 0xDC00 && u <= 0xDFFF && (c->flags & LEPT_PARSE_CHECK_UTF8)) {
+							STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);  /* 单独的低代理项编码后不是合法的 UTF-8 */
+						}
+						lept_encode_utf8(c, u);
+						break;
+					default:
+						STRING_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE);
+				}
+				break;
+			case '\0':
+				STRING_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK);
+			default:
+				if ((unsigned char)ch < 0x20) {
+					STRING_ERROR(LEPT_PARSE_INVALID_STRING_CHAR);
+				}
+				if ((unsigned char)ch >= 0x80 && (c->flags & LEPT_PARSE_CHECK_UTF8)) {
+					/* 只有非 ASCII 字节才检查，ASCII 字符不增加任何开销 */
+					if (!(q = lept_parse_utf8(p - 1))) {
+						STRING_ERROR(LEPT_PARSE_INVALID_UTF8);
+					}
+					PUTS(c, p - 1, (size_t)(q - p + 1));
+					p = q;
+					break;
+				}
+				PUTC(c, ch);
+		}
+	}
+}
+
+static int lept_parse_string(lept_context* c, lept_value* v) {
+	int ret, clean;
+	char* s;
+	size_t len;
+	if ((ret = lept_parse_string_raw(c, &s, &len, &clean)) == LEPT_PARSE_OK) {
+		lept_set_string_flags(v, s, len, clean ? LEPT_FLAG_CLEAN : 0);
+	}
+	return ret;
+}
+
+/*
+	路径过滤：解析时按 JSON Pointer（RFC 6901）形式的路径决定哪些子树不需要建立，
+	可以去掉路径所指的值（排除），也可以只保留路径所指的值和它们的祖先（投影）。
+	所有路径编译成一棵字典树，每个结点是一个路径段，段为 "*" 时匹配任意键或下标。
+	解析容器时 c->filter 指向对应的结点，为 NULL 表示这棵子树不需要再判断，所以没有过滤的部分不增加开销。
+	编译时把 "*" 子树合并进每个具体的兄弟结点，匹配时具体的键优先，找到一个结点就够了。
+*/
+
+struct lept_path_node {
+	lept_path_node* child;		/* 具体的键或下标，用 sibling 串成链表 */
+	lept_path_node* sibling;
+	lept_path_node* wildcard;	/* 段为 "*" 的子结点 */
+	size_t index;				/* 段是数组下标时为下标，否则为 (size_t)-1 */
+	int terminal;				/* 是某条路径的终点 */
+	char* k;					/* 段的内容（已还原 ~0、~1），存放在结点之后 */
+	size_t klen;
+};
+
+static size_t lept_path_index(const char* key, size_t klen) {
+	/* 段是数组下标时返回下标，否则返回 (size_t)-1；与 RFC 6901 一样，下标不能有多余的前导 0 */
+	size_t i, index = 0;
+	if (klen == 0 || (key[0] == '0' && klen > 1)) {
+		return (size_t)-1;
+	}
+	for (i = 0; i < klen; ++i) {
+		if (!ISDIGIT(key[i]) || index > ((size_t)-1 - 10) / 10) {
+			return (size_t)-1;
+		}
+		index = index * 10 + (size_t)(key[i] - '0');
+	}
+	return index;
+}
+
+static int lept_path_segment(const char** p, char* key, size_t* klen) {
+	/* *p 指向 '/'，把这一段还原 ~0、~1 后写入 key，*p 移到段尾；有不合法的 '~' 时返回 0 */
+	const char* q = *p + 1;
+	size_t n = 0;
+	for (; *q != '/' && *q != '\0'; ++q) {
+		if (*q == '~') {
+			if (q[1] != '0' && q[1] != '1') {
+				return 0;
+			}
+			key[n++] = *++q == '0' ? '~' : '/';
+		} else {
+			key[n++] = *q;
+		}
+	}
+	*p = q;
+	*klen = n;
+	return 1;
+}
+
+static lept_path_node* lept_path_node_new(const char* key, size_t klen) {
+	lept_path_node* n = (lept_path_node*)malloc(sizeof(lept_path_node) + klen + 1);
+	n->child = n->sibling = n->wildcard = NULL;
+	n->terminal = 0;
+	n->k = (char*)(n + 1);
+	memcpy(n->k, key, klen);
+	n->k[klen] = '\0';
+	n->klen = klen;
+	n->index = lept_path_index(key, klen);
+	return n;
+}
+
+static lept_path_node* lept_path_child(lept_path_node* n, const char* key, size_t klen, int wildcard) {
+	/* 找到或新建 n 的子结点 */
+	lept_path_node* e;
+	if (wildcard) {
+		return n->wildcard != NULL ? n->wildcard : (n->wildcard = lept_path_node_new("*", 1));
+	}
+	for (e = n->child; e != NULL; e = e->sibling) {
+		if (e->klen == klen && memcmp(e->k, key, klen) == 0) {
+			return e;
+		}
+	}
+	e = lept_path_node_new(key, klen);
+	e->sibling = n->child;
+	n->child = e;
+	return e;
+}
+
+static int lept_path_add(lept_path_node* root, const char* path) {
+	/* path 为 "" 时是整个文档，否则每段以 '/' 开头；不合法时返回 0，已加入的结点留给 lept_path_free() */
+	lept_path_node* n = root;
+	size_t len, klen;
+	char* key;
+	const char* p = path;
+	assert(path != NULL);
+	if (*path != '/' && *path != '\0') {
+		return 0;
+	}
+	len = strlen(path);
+	key = (char*)malloc(len + 1);
+	while (*p == '/') {
+		if (!lept_path_segment(&p, key, &klen)) {
+			free(key);
+			return 0;
+		}
+		n = lept_path_child(n, key, klen, klen == 1 && key[0] == '*');
+	}
+	n->terminal = 1;
+	free(key);
+	return 1;
+}
+
+static void lept_path_merge(lept_path_node* dst, const lept_path_node* src) {
+	/* 把 src 子树中的路径加到 dst 子树中 */
+	const lept_path_node* e;
+	dst->terminal |= src->terminal;
+	for (e = src->child; e != NULL; e = e->sibling) {
+		lept_path_merge(lept_path_child(dst, e->k, e->klen, 0), e);
+	}
+	if (src->wildcard != NULL) {
+		lept_path_merge(lept_path_child(dst, NULL, 0, 1), src->wildcard);
+	}
+}
+
+static void lept_path_normalize(lept_path_node* n) {
+	/* 具体的键也能匹配 "*"，所以把 "*" 子树合并进每个兄弟结点 */
+	lept_path_node* e;
+	for (e = n->child; e != NULL; e = e->sibling) {
+		if (n->wildcard != NULL) {
+			lept_path_merge(e, n->wildcard);
+		}
+		lept_path_normalize(e);
+	}
+	if (n->wildcard != NULL) {
+		lept_path_normalize(n->wildcard);
+	}
+}
+
+static void lept_path_free(lept_path_node* n) {
+	while (n != NULL) {
+		lept_path_node* next = n->sibling;
+		lept_path_free(n->child);
+		lept_path_free(n->wildcard);
+		free(n);
+		n = next;
+	}
+}
+
+static lept_path_node* lept_path_compile(const char* const* paths, size_t npaths) {
+	/* 有不合法的路径时返回 NULL */
+	lept_path_node* root = lept_path_node_new("", 0);
+	size_t i;
+	assert(paths != NULL || npaths == 0);
+	for (i = 0; i < npaths; ++i) {
+		if (!lept_path_add(root, paths[i])) {
+			lept_path_free(root);
+			return NULL;
+		}
+	}
+	lept_path_normalize(root);
+	return root;
+}
+
+static const lept_path_node* lept_path_match_key(const lept_path_node* n, const char* key, size_t klen) {
+	const lept_path_node* e;
+	for (e = n->child; e != NULL; e = e->sibling) {
+		if (e->klen == klen && memcmp(e->k, key, klen) == 0) {
+			return e;
+		}
+	}
+	return n->wildcard;
+}
+
+static const lept_path_node* lept_path_match_index(const lept_path_node* n, size_t index) {
+	const lept_path_node* e;
+	for (e = n->child; e != NULL; e = e->sibling) {
+		if (e->index == index) {
+			return e;
+		}
+	}
+	return n->wildcard;
+}
+
+static int lept_path_skip(lept_context* c, const lept_path_node* child) {
+	/*
+		child 是下一个值在 c->filter 下匹配到的结点，返回 1 表示跳过这个值，否则把 c->filter 设为解析它时的结点。
+		投影时跳过没有匹配的值，路径终点以下不再过滤；不是终点的匹配值只有是容器时才需要建立。
+	*/
+	if (!c->project) {
+		c->filter = child;
+		return child != NULL && child->terminal;
+	}
+	if (child == NULL) {
+		return 1;
+	}
+	c->filter = child->terminal ? NULL : child;
+	return !child->terminal && *c->json != '{' && *c->json != '[';
+}
+
+static int lept_parse_skip(lept_context* c) {
+	/* 跳过不需要的值，不分配内存 */
+	size_t offset;
+	int ret = lept_skip_value(c->json, (size_t)(c->end - c->json), !(c->flags & LEPT_PARSE_SKIP_UNCHECKED), &offset);
+	c->json += offset;
+	return ret;
+}
+
+static int lept_parse_value(lept_context* c, lept_value* v);  /* 前向声明 */
+
+static int lept_parse_array(lept_context* c, lept_value* v) {
+	size_t i, index, size = 0;
+	int ret, numbers = 1;
+	const lept_path_node* node = c->filter;
+	EXPECT(c, '[');
+	lept_parse_whitespace(c);
+	if (*c->json == ']') {
+		++c->json;
+		lept_set_array(v, 0);
+		return LEPT_PARSE_OK;
+	}
+	for (index = 0;; ++index) {
+		/*
+			如果此处写成以下代码，就会出现 bug：
+			lept_value* e = lept_context_push(c, sizeof(lept_value));
+			lept_init(e);
+			size++;
+			if ((ret = lept_parse_value(c, e)) != LEPT_PARSE_OK)
+				return ret;
+			原因：e 是一个指向堆区的指针，当我们的栈满的时候，就会自动扩容，原来的一片空间可能
+			就到其他地方去了，而 e 仍然指向原来的位置，成为悬空指针。
+		*/
+		lept_value e;
+		c->filter = NULL;
+		if (node != NULL && lept_path_skip(c, lept_path_match_index(node, index))) {
+			if ((ret = lept_parse_skip(c)) != LEPT_PARSE_OK) {
+				break;
+			}
+		} else {
+			lept_init(&e);
+			if ((ret = lept_parse_value(c, &e)) != LEPT_PARSE_OK) {
+				break;  /* 解析失败，堆栈中会存入这些非法值，在返回之前应当清空 */
+			}
+			memcpy(lept_context_push(c, sizeof(lept_value)), &e, sizeof(lept_value));
+			++size;
+			numbers &= e.type == LEPT_NUMBER;
+		}
+		lept_parse_whitespace(c);
+		if (*c->json == ',') {
+			++c->json;
+			lept_parse_whitespace(c);
+		} else if (*c->json == ']') {
+			++c->json;
+#if LEPT_PACKED_ARRAY_MIN > 0
+			if (numbers && (c->flags & LEPT_PARSE_PACK_ARRAYS) && size >= LEPT_PACKED_ARRAY_MIN) {
+				lept_value* e = (lept_value*)lept_context_pop(c, size * sizeof(lept_value));
+				lept_set_packed_array(v, size);
+				for (i = 0; i < size; ++i) {
+					v->u.pa.d[i] = e[i].u.n;
+				}
+				v->u.pa.size = size;
+				return LEPT_PARSE_OK;
+			}
+#endif
+			lept_set_array(v, size);
+			if (size > 0) {  /* 所有元素都被跳过时为 0 */
+				memcpy(v->u.a.e, lept_context_pop(c, size * sizeof(lept_value)), size * sizeof(lept_value));
+			}
+			v->u.a.size = size;
+			return LEPT_PARSE_OK;
+		} else {
+			ret = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+			break;  /* 解析失败，堆栈中会存入非法值之前的合法值，在返回之前应当清空 */
+		}
+	}
+	for (i = 0; i < size; ++i) {
+		lept_free((lept_value*)lept_context_pop(c, sizeof(lept_value)));
+	}
+	return ret;
+	/*
+		如果当解析数组时，第一个元素就出现错误，如果第一个元素是 null 或者数字等，
+		因为没有将保存数字的 lept_value 放在堆上，解析的时候也没有利用堆，所以不需要额外处理。
+		但是如果第一个元素是一个字符串，这个字符串前面一部分都合法，结尾时不合法，
+		那么前面的这一部分字符会先在堆上开辟一部分空间，然后把它们存进去，但是当遇到非法字符时，
+		就会调用 STRING_ERROR 来使得 c->top 回到一开始的地点，栈空间虽然变大了，
+		但 c-> top 回到了原来的地方，相当于并没有占用栈空间（这部分空间后面仍然可以用），
+		这部分的空间会在 lept_parse 的最后一起释放。
+	*/
+}
+
+static void lept_parse_unshape(lept_context* c, const lept_shape* shape, size_t size) {
+	/* 键太多，放弃形状：把栈顶的 size 个值换成带键的成员 */
+	size_t i;
+	lept_value* e = (lept_value*)malloc(size * sizeof(lept_value));
+	memcpy(e, lept_context_pop(c, size * sizeof(lept_value)), size * sizeof(lept_value));
+	for (i = 0; i < size; ++i) {
+		lept_member* m = (lept_member*)lept_context_push(c, sizeof(lept_member));
+		m->klen = shape->list->keys[i].klen;
+		memcpy(m->k = (char*)malloc(m->klen + 1), shape->list->keys[i].k, m->klen + 1);
+		memcpy(&m->v, &e[i], sizeof(lept_value));
+	}
+	free(e);
+}
+
+static int lept_parse_object(lept_context* c, lept_value* v) {
+	size_t i, size;
+	lept_member m;
+	lept_shape* shape;
+	const lept_path_node* node = c->filter;
+	int ret, skip;
+	EXPECT(c, '{');
+	lept_parse_whitespace(c);
+	if (*c->json == '}') {
+		++c->json;
+		lept_set_object(v, 0);
+		return LEPT_PARSE_OK;
+	}
+	m.k = NULL;
+	size = 0;
+	/*
+		shape 不为 NULL 时，栈上只压入值，键记录在 shape 中，键字符串不需要 malloc；
+		形状的键数或转移边数到了上限后 shape 置为 NULL，改为压入 lept_member。
+		解析过程持有形状树的一个引用，shape 本身不计引用
+	*/
+	shape = NULL;
+	if (LEPT_SHAPE_MAX_KEYS > 0) {
+		if (c->shapes == NULL) {
+			c->shapes = lept_shape_tree_new();
+		}
+		shape = c->shapes;
+	}
+	for (;;) {
+		char* str;
+		int clean;  /* 键的转义标志由形状自己记录 */
+		lept_init(&m.v);
+		/* 解析 key */
+		if (*c->json != '"') {
+			ret = LEPT_PARSE_MISS_KEY;
+			break;
+		}
+		if ((ret = lept_parse_string_raw(c, &str, &m.klen, &clean)) != LEPT_PARSE_OK) {
+			break;
+		}
+		/* 解析空白和冒号，不会用到栈 */
+		lept_parse_whitespace(c);
+		if (*c->json != ':') {
+			ret = LEPT_PARSE_MISS_COLON;
+			break;
+		}
+		++c->json;
+		lept_parse_whitespace(c);
+		c->filter = NULL;
+		skip = node != NULL && lept_path_skip(c, lept_path_match_key(node, str, m.klen));
+		if (!skip) {
+			/* 跳过的成员，键和值都不加入对象；str 仍指向栈中已弹出的区域，要在解析值之前用掉 */
+			lept_shape* next = NULL;
+			if (shape != NULL) {
+				unsigned hash = lept_hash_key(str, m.klen);
+				if ((next = lept_shape_child(shape, str, m.klen, hash)) == NULL) {
+					next = lept_shape_add(shape, str, m.klen, hash);
+				}
+			}
+			if (next != NULL) {
+				shape = next;
+			} else {
+				memcpy(m.k = (char*)malloc(m.klen + 1), str, m.klen);
+				m.k[m.klen] = '\0';
+				if (shape != NULL) {
+					lept_parse_unshape(c, shape, size);  /* 要在复制键之后做，否则会覆盖栈上的键字符串 */
+					shape = NULL;
+				}
+			}
+		}
+		/* 解析值 value */
+		if (skip) {
+			if ((ret = lept_parse_skip(c)) != LEPT_PARSE_OK) {
+				break;
+			}
+		} else {
+			if ((ret = lept_parse_value(c, &m.v)) != LEPT_PARSE_OK) {
+				break;
+			}
+			if (shape != NULL) {
+				memcpy(lept_context_push(c, sizeof(lept_value)), &m.v, sizeof(lept_value));
+			} else {
+				memcpy(lept_context_push(c, sizeof(lept_member)), &m, sizeof(lept_member));
+			}
+			++size;
+			m.k = NULL;
+		}
+		/*
+			如果之前缺乏冒号，或是这里解析值失败，在函数返回前我们要释放 m.k。
+			如果我们成功地解析整个成员，那么就要把 m.k 设为空指针，
+			其意义是说明该键的字符串的拥有权已转移至栈，之后如遇到错误，
+			我们不会重覆释放栈里成员的键和这个临时成员的键。
+		*/
+		/* 解析逗号或者右花括号 */
+		lept_parse_whitespace(c);
+		if (*c->json == ',') {
+			++c->json;
+			lept_parse_whitespace(c);
+		} else if (*c->json == '}') {
+			++c->json;
+			if (size == 0) {
+				/* 所有成员都被跳过 */
+				lept_set_object(v, 0);
+			} else if (shape != NULL) {
+				lept_set_shaped_object(v, lept_shape_retain(shape), size);
+				memcpy(v->u.so.v, lept_context_pop(c, sizeof(lept_value) * size), sizeof(lept_value) * size);
+			} else {
+				lept_set_object(v, size);
+				memcpy(v->u.o.m, lept_context_pop(c, sizeof(lept_member) * size), sizeof(lept_member) * size);
+				v->u.o.size = size;
+			}
+			return LEPT_PARSE_OK;
+		} else {
+			ret = LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+			break;
+		}
+	}
+	/*
+		最后，当 for (;;) 中遇到任何错误便会到达这步，
+		要释放临时的 key 字符串及栈上的成员。
+	*/
+	free(m.k);
+	for (i = 0; i < size; ++i) {
+		if (shape != NULL) {
+			lept_free((lept_value*)lept_context_pop(c, sizeof(lept_value)));
+		} else {
+			lept_member* m = (lept_member*)lept_context_pop(c, sizeof(lept_member));
+			free(m->k);
+			lept_free(&m->v);
+		}
+	}
+	v->type = LEPT_NULL;
+	return ret;
+}
+
+static int lept_parse_value(lept_context* c, lept_value* v) {
+	switch (*c->json) {
+		case 'n':  return lept_parse_literal(c, v, "null", LEPT_NULL);
+		case 't':  return lept_parse_literal(c, v, "true", LEPT_TRUE);
+		case 'f':  return lept_parse_literal(c, v, "false", LEPT_FALSE);
+		default:   return lept_parse_number(c, v);
+		case '"':  return lept_parse_string(c, v);
+		case '[':  return lept_parse_array(c, v);
+		case '{':  return lept_parse_object(c, v);
+		case '\0': return LEPT_PARSE_EXPECT_VALUE;
+	}
+}
+
+static int lept_parse_root(lept_value* v, const char* json, size_t len, int flags, const lept_path_node* filter, int project, size_t* err_offset) {
+	/* 出错时 c.json 停在出错处，成功时不需要任何额外的记录 */
+	lept_context c;
+	int ret;
+	assert(v != NULL);
+	c.json = json;
+	c.flags = flags;
+	c.filter = filter;
+	c.project = project;
+	c.end = json + len;
+	c.shapes = NULL;
+	c.stack = NULL;
+	c.size = c.top = 0;
+	c.write = NULL;
+	lept_init(v);
+	lept_parse_whitespace(&c);
+	if (filter != NULL && filter->terminal) {
+		/* 路径 "" 是整个文档 */
+		c.filter = NULL;
+		ret = project ? lept_parse_value(&c, v) : lept_parse_skip(&c);
+	} else {
+		ret = lept_parse_value(&c, v);
+	}
+	if (ret == LEPT_PARSE_OK) {
+		lept_parse_whitespace(&c);
+		if (*c.json != '\0') {
+			lept_free(v);  /* 如果不置空，那么 c->json = "0123" 就会将 type 改成 LEPT_NUMBER；用 lept_free() 以免泄漏已解析的容器 */
+			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+		}
+	}
+	if (ret != LEPT_PARSE_OK && err_offset != NULL) {
+		*err_offset = (size_t)(c.json - json);
+	}
+	assert(c.top == 0);
+	free(c.stack);  /* 解析完毕后，要将堆区申请的空间释放 */
+	if (c.shapes != NULL) {
+		lept_shape_release(c.shapes);  /* 没有对象用到形状树时在这里释放 */
+	}
+	return ret;
+}
+
+int lept_parse_ex(lept_value* v, const char* json, int flags, size_t* err_offset) {
+	return lept_parse_root(v, json, 0, flags, NULL, 0, err_offset);  /* 不过滤时不需要长度 */
+}
+
+int lept_parse_excluding(lept_value* v, const char* json, const char* const* paths, size_t npaths, int flags) {
+	lept_path_node* filter;
+	int ret;
+	assert(v != NULL);
+	if ((filter = lept_path_compile(paths, npaths)) == NULL) {
+		lept_init(v);
+		return LEPT_PARSE_INVALID_POINTER;
+	}
+	ret = lept_parse_root(v, json, strlen(json), flags, filter, 0, NULL);
+	lept_path_free(filter);
+	return ret;
+}
+
+int lept_parse_projected(lept_value* v, const char* json, size_t len, const char* const* paths, size_t npaths) {
+	lept_path_node* filter;
+	int ret;
+	assert(v != NULL && json != NULL && json[len] == '\0');
+	if ((filter = lept_path_compile(paths, npaths)) == NULL) {
+		lept_init(v);
+		return LEPT_PARSE_INVALID_POINTER;
+	}
+	ret = lept_parse_root(v, json, len, 0, filter, 1, NULL);
+	lept_path_free(filter);
+	return ret;
+}
+
+/*
+	JSONPath 子集：$、.name、['name']、.*、[*]、[n]、[start:end:step]，以及在这些前面加 .. 的递归下降。
+	编译后每一步是一个 lept_jsonpath_step，求值时把“下一个要匹配第几步”的所有可能记在位集合 state 中（NFA），
+	第 i 位表示下一个要匹配第 i 步，第 size 位表示已经匹配了整条路径。
+	按 state 边解析边匹配：匹配整条路径的值才解析成 lept_value 交给回调，之后立即释放；
+	state 为空的子树用 lept_skip_value() 跳过，不分配内存。
+*/
+
+#ifndef LEPT_JSONPATH_MAX_STEPS
+#define LEPT_JSONPATH_MAX_STEPS 31	/* state 用 unsigned long 的位表示，最多 31 步 */
+#endif
+
+typedef enum { LEPT_STEP_NAME, LEPT_STEP_WILDCARD, LEPT_STEP_SLICE } lept_step_type;
+
+typedef struct {
+	lept_step_type type;
+	int descendant;			/* 由 .. 引入，也匹配更深层的值 */
+	char* k;				/* LEPT_STEP_NAME 的键 */
+	size_t klen;
+	size_t start, end, step;	/* LEPT_STEP_SLICE 的下标范围，[n] 是 [n:n+1:1] */
+}lept_jsonpath_step;
+
+struct lept_jsonpath {
+	size_t size;
+	lept_jsonpath_step steps[LEPT_JSONPATH_MAX_STEPS];
+};
+
+typedef struct {
+	lept_context c;
+	const lept_jsonpath* path;
+	lept_match_fn fn;
+	void* ud;
+	int stopped;			/* 回调返回非 0 后不再继续 */
+}lept_jsonpath_eval_context;
+
+static const char* lept_jsonpath_size(const char* p, size_t* n) {
+	/* 读一个非负整数，没有数字时返回 NULL */
+	const char* q = p;
+	for (*n = 0; ISDIGIT(*p); ++p) {
+		if (*n > ((size_t)-1 - 10) / 10) {
+			return NULL;
+		}
+		*n = *n * 10 + (size_t)(*p - '0');
+	}
+	return p != q ? p : NULL;
+}
+
+static const char* lept_jsonpath_bracket(const char* p, lept_jsonpath_step* s) {
+	/* p 指向 '[' 之后，解析到 ']' 之后，语法错误时返回 NULL */
+	if (*p == '*') {
+		s->type = LEPT_STEP_WILDCARD;
+		++p;
+	} else if (*p == '\'' || *p == '"') {
+		char quote = *p++;
+		const char* q;
+		size_t n = 0;
+		for (q = p; *q != quote; ++q) {
+			if (*q == '\0') {
+				return NULL;
+			}
+			q += *q == '\\' && q[1] != '\0';
+		}
+		s->type = LEPT_STEP_NAME;
+		s->k = (char*)malloc((size_t)(q - p) + 1);
+		for (; p < q; ++p) {
+			p += *p == '\\';  /* \' 和 \\ 等只保留后一个字符 */
+			s->k[n++] = *p;
+		}
+		s->k[n] = '\0';
+		s->klen = n;
+		++p;
+	} else {
+		s->type = LEPT_STEP_SLICE;
+		s->start = 0;
+		s->end = (size_t)-1;
+		s->step = 1;
+		if (*p != ':' && (p = lept_jsonpath_size(p, &s->start)) == NULL) {
+			return NULL;
+		}
+		if (*p != ':') {
+			s->end = s->start + 1;  /* [n] */
+		} else {
+			++p;
+			if (ISDIGIT(*p) && (p = lept_jsonpath_size(p, &s->end)) == NULL) {
+				return NULL;
+			}
+			if (*p == ':') {
+				++p;
+				if (ISDIGIT(*p) && ((p = lept_jsonpath_size(p, &s->step)) == NULL || s->step == 0)) {
+					return NULL;
+				}
+			}
+		}
+	}
+	return *p == ']' ? p + 1 : NULL;
+}
+
+lept_jsonpath* lept_jsonpath_compile(const char* path) {
+	lept_jsonpath* ret;
+	const char* p = path;
+	assert(path != NULL);
+	if (*p++ != '$') {
+		return NULL;
+	}
+	ret = (lept_jsonpath*)malloc(sizeof(lept_jsonpath));
+	ret->size = 0;
+	while (*p != '\0') {
+		lept_jsonpath_step* s = &ret->steps[ret->size];
+		if (ret->size == LEPT_JSONPATH_MAX_STEPS) {
+			break;
+		}
+		s->descendant = 0;
+		s->k = NULL;
+		if (p[0] == '.' && p[1] == '.') {
+			s->descendant = 1;
+			p += 2;
+			if (*p == '[') {
+				++p;
+				if ((p = lept_jsonpath_bracket(p, s)) == NULL) {
+					break;
+				}
+				++ret->size;
+				continue;
+			}
+		} else if (*p == '.') {
+			++p;
+		} else if (*p == '[') {
+			++p;
+			if ((p = lept_jsonpath_bracket(p, s)) == NULL) {
+				break;
+			}
+			++ret->size;
+			continue;
+		} else {
+			break;
+		}
+		/* .name 或 .* */
+		if (*p == '*') {
+			s->type = LEPT_STEP_WILDCARD;
+			++p;
+		} else {
+			const char* q = p;
+			while (*q != '\0' && *q != '.' && *q != '[') {
+				++q;
+			}
+			if (q == p) {
+				p = NULL;  /* 名字为空 */
+				break;
+			}
+			s->type = LEPT_STEP_NAME;
+			s->klen = (size_t)(q - p);
+			memcpy(s->k = (char*)malloc(s->klen + 1), p, s->klen);
+			s->k[s->klen] = '\0';
+			p = q;
+		}
+		++ret->size;
+	}
+	if (p == NULL || *p != '\0') {
+		/* 语法错误，或超过 LEPT_JSONPATH_MAX_STEPS 步 */
+		if (ret->size < LEPT_JSONPATH_MAX_STEPS) {
+			free(ret->steps[ret->size].k);  /* 解析到一半的这一步 */
+		}
+		lept_jsonpath_free(ret);
+		return NULL;
+	}
+	return ret;
+}
+
+void lept_jsonpath_free(lept_jsonpath* path) {
+	size_t i;
+	if (path != NULL) {
+		for (i = 0; i < path->size; ++i) {
+			free(path->steps[i].k);
+		}
+		free(path);
+	}
+}
+
+static unsigned long lept_jsonpath_next(const lept_jsonpath* path, unsigned long state, const char* key, size_t klen, size_t index) {
+	/* 从 state 经过一个成员（key 不为 NULL）或数组的第 index 个元素后的 state */
+	unsigned long next = 0;
+	size_t i;
+	for (i = 0; i < path->size; ++i) {
+		const lept_jsonpath_step* s = &path->steps[i];
+		if (!((state >> i) & 1)) {
+			continue;
+		}
+		if (s->descendant) {
+			next |= 1ul << i;
+		}
+		if (s->type == LEPT_STEP_WILDCARD ||
+			(s->type == LEPT_STEP_NAME && key != NULL && s->klen == klen && memcmp(s->k, key, klen) == 0) ||
+			(s->type == LEPT_STEP_SLICE && key == NULL && index >= s->start && index < s->end && (index - s->start) % s->step == 0)) {
+			next |= 1ul << (i + 1);
+		}
+	}
+	return next;
+}
+
+static void lept_jsonpath_walk(lept_jsonpath_eval_context* e, lept_value* v, unsigned long state) {
+	/* 匹配的值已经建立，用同样的 state 在树上找其中更深的匹配（只有递归下降时才会有） */
+	unsigned long final = 1ul << e->path->size;
+	size_t i, size;
+	if (v->type != LEPT_OBJECT && v->type != LEPT_ARRAY) {
+		return;
+	}
+	size = v->type == LEPT_OBJECT ? lept_get_object_size(v) : lept_get_array_size(v);
+	for (i = 0; i < size && !e->stopped; ++i) {
+		lept_value* child;
+		unsigned long next;
+		if (v->type == LEPT_OBJECT) {
+			next = lept_jsonpath_next(e->path, state, lept_get_object_key(v, i), lept_get_object_key_length(v, i), 0);
+			child = lept_get_object_value(v, i);
+		} else {
+			next = lept_jsonpath_next(e->path, state, NULL, 0, i);
+			child = lept_get_array_element(v, i);
+		}
+		if (next & final) {
+			e->stopped = e->fn(e->ud, child);
+		}
+		if ((next & ~final) != 0 && !e->stopped) {
+			lept_jsonpath_walk(e, child, next & ~final);
+		}
+	}
+}
+
+static int lept_jsonpath_container(lept_jsonpath_eval_context* e, unsigned long state);  /* 前向声明 */
+
+static int lept_jsonpath_value(lept_jsonpath_eval_context* e, unsigned long state) {
+	/* c->json 指向一个值，state 是到达这个值之后的状态 */
+	lept_context* c = &e->c;
+	unsigned long final = 1ul << e->path->size;
+	if (state & final) {
+		lept_value v;
+		int ret;
+		lept_init(&v);
+		if ((ret = lept_parse_value(c, &v)) == LEPT_PARSE_OK) {
+			e->stopped = e->fn(e->ud, &v);
+			if ((state & ~final) != 0 && !e->stopped) {
+				lept_jsonpath_walk(e, &v, state & ~final);
+			}
+		}
+		lept_free(&v);
+		return ret;
+	}
+	if (state == 0 || (*c->json != '{' && *c->json != '[')) {
+		return lept_parse_skip(c);
+	}
+	return lept_jsonpath_container(e, state);
+}
+
+static int lept_jsonpath_container(lept_jsonpath_eval_context* e, unsigned long state) {
+	/* 与 lept_parse_object()、lept_parse_array() 的语法和错误码相同，但不建立容器 */
+	lept_context* c = &e->c;
+	int object = *c->json == '{';
+	char close = object ? '}' : ']';
+	size_t index;
+	int ret;
+	++c->json;
+	lept_parse_whitespace(c);
+	if (*c->json == close) {
+		++c->json;
+		return LEPT_PARSE_OK;
+	}
+	for (index = 0; !e->stopped; ++index) {
+		unsigned long next;
+		if (object) {
+			char* str;
+			size_t klen;
+			int clean;
+			if (*c->json != '"') {
+				return LEPT_PARSE_MISS_KEY;
+			}
+			if ((ret = lept_parse_string_raw(c, &str, &klen, &clean)) != LEPT_PARSE_OK) {
+				return ret;
+			}
+			next = lept_jsonpath_next(e->path, state, str, klen, 0);  /* str 在栈上，要在解析值之前用掉 */
+			lept_parse_whitespace(c);
+			if (*c->json != ':') {
+				return LEPT_PARSE_MISS_COLON;
+			}
+			++c->json;
+			lept_parse_whitespace(c);
+		} else {
+			next = lept_jsonpath_next(e->path, state, NULL, 0, index);
+		}
+		if ((ret = lept_jsonpath_value(e, next)) != LEPT_PARSE_OK) {
+			return ret;
+		}
+		lept_parse_whitespace(c);
+		if (*c->json == ',') {
+			++c->json;
+			lept_parse_whitespace(c);
+		} else if (*c->json == close) {
+			++c->json;
+			return LEPT_PARSE_OK;
+		} else {
+			return object ? LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+		}
+	}
+	return LEPT_PARSE_OK;
+}
+
+int lept_jsonpath_eval(const lept_jsonpath* path, const char* json, size_t len, lept_match_fn fn, void* ud) {
+	lept_jsonpath_eval_context e;
+	int ret;
+	assert(path != NULL && json != NULL && json[len] == '\0' && fn != NULL);
+	e.path = path;
+	e.fn = fn;
+	e.ud = ud;
+	e.stopped = 0;
+	e.c.json = json;
+	e.c.flags = 0;
+	e.c.filter = NULL;
+	e.c.project = 0;
+	e.c.end = json + len;
+	e.c.shapes = NULL;
+	e.c.stack = NULL;
+	e.c.size = e.c.top = 0;
+	e.c.write = NULL;
+	lept_parse_whitespace(&e.c);
+	ret = lept_jsonpath_value(&e, 1ul);  /* 根值之前要匹配第 0 步 */
+	if (ret == LEPT_PARSE_OK && !e.stopped) {
+		lept_parse_whitespace(&e.c);
+		if (*e.c.json != '\0') {
+			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+		}
+	}
+	free(e.c.stack);
+	if (e.c.shapes != NULL) {
+		lept_shape_release(e.c.shapes);
+	}
+	return ret;
+}
+
+int lept_parse(lept_value* v, const char* json) {
+	return lept_parse_ex(v, json, 0, NULL);
+}
+
+void lept_get_error_position(const char* json, size_t offset, size_t* line, size_t* column) {
+	/* 只在需要报告错误时调用，从头数换行符 */
+	const char* p = json;
+	const char* end = json + offset;
+	const char* nl;
+	assert(json != NULL && line != NULL && column != NULL);
+	*line = 1;
+	while ((nl = (const char*)memchr(p, '\n', (size_t)(end - p))) != NULL) {
+		++*line;
+		p = nl + 1;
+	}
+	*column = (size_t)(end - p) + 1;
+}
+
+#if 0
+/* 未优化 */
+static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
+	size_t i;
+	assert(s != NULL);
+	PUTC(c, '"');
+	for (i = 0; i < len; ++i) {
+		unsigned char ch = (unsigned char)s[i];
+		switch (ch) {
+			case '\"':	PUTS(c, "\\\"", 2); break;
+			case '\\':	PUTS(c, "\\\\", 2); break;
+			case '\b':	PUTS(c, "\\b", 2); break;
+			case '\f':	PUTS(c, "\\f", 2); break;
+			case '\n':	PUTS(c, "\\n", 2); break;
+			case '\r':	PUTS(c, "\\r", 2); break;
+			case '\t':	PUTS(c, "\\t", 2); break;
+			default:
+				if (ch < 0x20) {
+					char buffer[7];
+					sprintf(buffer, "\\u%04X", ch);
+					PUTS(c, buffer, 6);
+				} else {
+					PUTC(c, s[i]);
+				}
+		}
+	}
+	PUTC(c, '"');
+}
+#else
+/*
+	优化后：先找出不需要转义的连续片段整段 memcpy，只有需要转义的字符才逐个处理。
+	不再预先按 6 * len + 2 预留空间，大字符串的峰值内存约为原长。
+*/
+static void lept_stringify_clean_string(lept_context* c, const char* s, size_t len) {
+	/* 已知不需要转义，一次复制 */
+	char* p;
+	if ((c->write != NULL && c->top + len + 2 >= c->size) || (c->iov != NULL && len >= LEPT_IOVEC_REF_MIN)) {
+		PUTC(c, '"');
+		lept_context_write(c, s, len);
+		PUTC(c, '"');
+		return;
+	}
+	p = lept_context_push(c, len + 2);
+	p[0] = '"';
+	memcpy(p + 1, s, len);
+	p[len + 1] = '"';
+}
+
+static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
+	static const char hex_digits[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+	const char* hex = c->canon != NULL ? "0123456789abcdef" : hex_digits;  /* 规范形式用小写 */
+	size_t i = 0, n;
+	char* p;
+	assert(s != NULL);
+	PUTC(c, '"');
+	for (;;) {
+		n = lept_scan_clean(s + i, len - i);
+		if (n > 0) {
+			lept_context_write(c, s + i, n);
+			i += n;
+		}
+		if (i == len) {
+			break;
+		}
+		switch (s[i]) {
+			case '\"': PUTS(c, "\\\"", 2); break;
+			case '\\': PUTS(c, "\\\\", 2); break;
+			case '\b': PUTS(c, "\\b", 2);  break;
+			case '\f': PUTS(c, "\\f", 2);  break;
+			case '\n': PUTS(c, "\\n", 2);  break;
+			case '\r': PUTS(c, "\\r", 2);  break;
+			case '\t': PUTS(c, "\\t", 2);  break;
+			default:
+				p = lept_context_push(c, 6);
+				p[0] = '\\'; p[1] = 'u'; p[2] = '0'; p[3] = '0';
+				p[4] = hex[(unsigned char)s[i] >> 4];
+				p[5] = hex[s[i] & 15];
+		}
+		++i;
+	}
+	PUTC(c, '"');
+}
+#endif
+
+/*
+	数字格式化：Grisu2 算法（Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers"）。
+	输出能被 strtod() 精确还原的最短（或极接近最短）的十进制数字，不依赖 sprintf() 和 locale。
+	输出格式与 "%.17g" 相同：首位数字的十进制指数小于 -4 或不小于 17 时用科学计数法，指数至少两位。
+*/
+
+#if defined(_MSC_VER)
+typedef unsigned __int64 lept_uint64;
+#elif defined(__GNUC__)
+__extension__ typedef unsigned long long lept_uint64;  /* C89 没有 64 位整数，用 __extension__ 避免 -pedantic 警告 */
+#else
+typedef unsigned long long lept_uint64;
+#endif
+
+#define LEPT_UINT64_C(h, l)		(((lept_uint64)(h) << 32) | (lept_uint64)(l))
+
+typedef struct {
+	lept_uint64 f;
+	int e;
+}lept_diyfp;	/* f * 2^e */
+
+static const lept_uint64 lept_cached_powers_f[] = {
+	LEPT_UINT64_C(0xfa8fd5a0, 0x081c0288), LEPT_UINT64_C(0xbaaee17f, 0xa23ebf76),
+	LEPT_UINT64_C(0x8b16fb20, 0x3055ac76), LEPT_UINT64_C(0xcf42894a, 0x5dce35ea),
+	LEPT_UINT64_C(0x9a6bb0aa, 0x55653b2d), LEPT_UINT64_C(0xe61acf03, 0x3d1a45df),
+	LEPT_UINT64_C(0xab70fe17, 0xc79ac6ca), LEPT_UINT64_C(0xff77b1fc, 0xbebcdc4f),
+	LEPT_UINT64_C(0xbe5691ef, 0x416bd60c), LEPT_UINT64_C(0x8dd01fad, 0x907ffc3c),
+	LEPT_UINT64_C(0xd3515c28, 0x31559a83), LEPT_UINT64_C(0x9d71ac8f, 0xada6c9b5),
+	LEPT_UINT64_C(0xea9c2277, 0x23ee8bcb), LEPT_UINT64_C(0xaecc4991, 0x4078536d),
+	LEPT_UINT64_C(0x823c1279, 0x5db6ce57), LEPT_UINT64_C(0xc2109436, 0x4dfb5637),
+	LEPT_UINT64_C(0x9096ea6f, 0x3848984f), LEPT_UINT64_C(0xd77485cb, 0x25823ac7),
+	LEPT_UINT64_C(0xa086cfcd, 0x97bf97f4), LEPT_UINT64_C(0xef340a98, 0x172aace5),
+	LEPT_UINT64_C(0xb23867fb, 0x2a35b28e), LEPT_UINT64_C(0x84c8d4df, 0xd2c63f3b),
+	LEPT_UINT64_C(0xc5dd4427, 0x1ad3cdba), LEPT_UINT64_C(0x936b9fce, 0xbb25c996),
+	LEPT_UINT64_C(0xdbac6c24, 0x7d62a584), LEPT_UINT64_C(0xa3ab6658, 0x0d5fdaf6),
+	LEPT_UINT64_C(0xf3e2f893, 0xdec3f126), LEPT_UINT64_C(0xb5b5ada8, 0xaaff80b8),
+	LEPT_UINT64_C(0x87625f05, 0x6c7c4a8b), LEPT_UINT64_C(0xc9bcff60, 0x34c13053),
+	LEPT_UINT64_C(0x964e858c, 0x91ba2655), LEPT_UINT64_C(0xdff97724, 0x70297ebd),
+	LEPT_UINT64_C(0xa6dfbd9f, 0xb8e5b88f), LEPT_UINT64_C(0xf8a95fcf, 0x88747d94),
+	LEPT_UINT64_C(0xb9447093, 0x8fa89bcf), LEPT_UINT64_C(0x8a08f0f8, 0xbf0f156b),
+	LEPT_UINT64_C(0xcdb02555, 0x653131b6), LEPT_UINT64_C(0x993fe2c6, 0xd07b7fac),
+	LEPT_UINT64_C(0xe45c10c4, 0x2a2b3b06), LEPT_UINT64_C(0xaa242499, 0x697392d3),
+	LEPT_UINT64_C(0xfd87b5f2, 0x8300ca0e), LEPT_UINT64_C(0xbce50864, 0x92111aeb),
+	LEPT_UINT64_C(0x8cbccc09, 0x6f5088cc), LEPT_UINT64_C(0xd1b71758, 0xe219652c),
+	LEPT_UINT64_C(0x9c400000, 0x00000000), LEPT_UINT64_C(0xe8d4a510, 0x00000000),
+	LEPT_UINT64_C(0xad78ebc5, 0xac620000), LEPT_UINT64_C(0x813f3978, 0xf8940984),
+	LEPT_UINT64_C(0xc097ce7b, 0xc90715b3), LEPT_UINT64_C(0x8f7e32ce, 0x7bea5c70),
+	LEPT_UINT64_C(0xd5d238a4, 0xabe98068), LEPT_UINT64_C(0x9f4f2726, 0x179a2245),
+	LEPT_UINT64_C(0xed63a231, 0xd4c4fb27), LEPT_UINT64_C(0xb0de6538, 0x8cc8ada8),
+	LEPT_UINT64_C(0x83c7088e, 0x1aab65db), LEPT_UINT64_C(0xc45d1df9, 0x42711d9a),
+	LEPT_UINT64_C(0x924d692c, 0xa61be758), LEPT_UINT64_C(0xda01ee64, 0x1a708dea),
+	LEPT_UINT64_C(0xa26da399, 0x9aef774a), LEPT_UINT64_C(0xf209787b, 0xb47d6b85),
+	LEPT_UINT64_C(0xb454e4a1, 0x79dd1877), LEPT_UINT64_C(0x865b8692, 0x5b9bc5c2),
+	LEPT_UINT64_C(0xc83553c5, 0xc8965d3d), LEPT_UINT64_C(0x952ab45c, 0xfa97a0b3),
+	LEPT_UINT64_C(0xde469fbd, 0x99a05fe3), LEPT_UINT64_C(0xa59bc234, 0xdb398c25),
+	LEPT_UINT64_C(0xf6c69a72, 0xa3989f5c), LEPT_UINT64_C(0xb7dcbf53, 0x54e9bece),
+	LEPT_UINT64_C(0x88fcf317, 0xf22241e2), LEPT_UINT64_C(0xcc20ce9b, 0xd35c78a5),
+	LEPT_UINT64_C(0x98165af3, 0x7b2153df), LEPT_UINT64_C(0xe2a0b5dc, 0x971f303a),
+	LEPT_UINT64_C(0xa8d9d153, 0x5ce3b396), LEPT_UINT64_C(0xfb9b7cd9, 0xa4a7443c),
+	LEPT_UINT64_C(0xbb764c4c, 0xa7a44410), LEPT_UINT64_C(0x8bab8eef, 0xb6409c1a),
+	LEPT_UINT64_C(0xd01fef10, 0xa657842c), LEPT_UINT64_C(0x9b10a4e5, 0xe9913129),
+	LEPT_UINT64_C(0xe7109bfb, 0xa19c0c9d), LEPT_UINT64_C(0xac2820d9, 0x623bf429),
+	LEPT_UINT64_C(0x80444b5e, 0x7aa7cf85), LEPT_UINT64_C(0xbf21e440, 0x03acdd2d),
+	LEPT_UINT64_C(0x8e679c2f, 0x5e44ff8f), LEPT_UINT64_C(0xd433179d, 0x9c8cb841),
+	LEPT_UINT64_C(0x9e19db92, 0xb4e31ba9), LEPT_UINT64_C(0xeb96bf6e, 0xbadf77d9),
+	LEPT_UINT64_C(0xaf87023b, 0x9bf0ee6b)
+};
+
+static const short lept_cached_powers_e[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+	-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+	-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+	-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+	-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+	109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+	641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+	907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const lept_uint64 lept_pow10[] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+	LEPT_UINT64_C(0x00000002, 0x540be400), LEPT_UINT64_C(0x00000017, 0x4876e800),
+	LEPT_UINT64_C(0x000000e8, 0xd4a51000), LEPT_UINT64_C(0x00000918, 0x4e72a000),
+	LEPT_UINT64_C(0x00005af3, 0x107a4000), LEPT_UINT64_C(0x00038d7e, 0xa4c68000),
+	LEPT_UINT64_C(0x002386f2, 0x6fc10000), LEPT_UINT64_C(0x01634578, 0x5d8a0000),
+	LEPT_UINT64_C(0x0de0b6b3, 0xa7640000), LEPT_UINT64_C(0x8ac72304, 0x89e80000)
+};
+
+static lept_diyfp lept_diyfp_make(lept_uint64 f, int e) {
+	lept_diyfp r;
+	r.f = f;
+	r.e = e;
+	return r;
+}
+
+static lept_diyfp lept_diyfp_multiply(lept_diyfp x, lept_diyfp y) {
+	/* 64 x 64 位乘法只保留高 64 位，并四舍五入 */
+	const lept_uint64 m32 = 0xFFFFFFFFu;
+	lept_uint64 a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+	lept_uint64 ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	lept_uint64 tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+	tmp += (lept_uint64)1 << 31;
+	return lept_diyfp_make(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64);
+}
+
+static lept_diyfp lept_diyfp_normalize(lept_diyfp x) {
+	while ((x.f & LEPT_UINT64_C(0x80000000, 0)) == 0) {
+		x.f <<= 1;
+		x.e--;
+	}
+	return x;
+}
+
+static void lept_grisu_round(char* buffer, int len, lept_uint64 delta, lept_uint64 rest, lept_uint64 ten_kappa, lept_uint64 wp_w) {
+	/* 在 (w-, w+) 范围内把最后一位向 w 靠近 */
+	while (rest < wp_w && delta - rest >= ten_kappa &&
+		(rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+		buffer[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+static int lept_count_decimal_digit(unsigned n) {
+	int d = 1;
+	while (d < 10 && n >= lept_pow10[d]) {
+		++d;
+	}
+	return d;
+}
+
+static int lept_grisu2(double d, char* buffer, int* k) {
+	/* d 必须是正的有限数，产生的数字写入 buffer，返回位数，d = buffer * 10^k */
+	lept_uint64 bits, f, delta, p2, wp_w;
+	lept_diyfp v, w, wp, wm, c, one;
+	unsigned p1;
+	int e, len = 0, kappa, index;
+	double dk;
+
+	memcpy(&bits, &d, sizeof(double));
+	f = bits & LEPT_UINT64_C(0x000FFFFF, 0xFFFFFFFF);
+	e = (int)((bits >> 52) & 0x7FF);
+	if (e != 0) {
+		v = lept_diyfp_make(f + LEPT_UINT64_C(0x00100000, 0), e - 1075);
+	} else {
+		v = lept_diyfp_make(f, 1 - 1075);
+	}
+
+	/* 边界 m+ 和 m-，规格化到相同的指数 */
+	wp = lept_diyfp_make((v.f << 1) + 1, v.e - 1);
+	while ((wp.f & LEPT_UINT64_C(0x00200000, 0)) == 0) {
+		wp.f <<= 1;
+		wp.e--;
+	}
+	wp.f <<= 10;
+	wp.e -= 10;
+	if (v.f == LEPT_UINT64_C(0x00100000, 0)) {
+		wm = lept_diyfp_make((v.f << 2) - 1, v.e - 2);
+	} else {
+		wm = lept_diyfp_make((v.f << 1) - 1, v.e - 1);
+	}
+	wm.f <<= wm.e - wp.e;
+	wm.e = wp.e;
+
+	/* 选取缓存的 10 的幂 c = 10^-k，使 wp * c 的指数落在 [-60, -32] */
+	dk = (-61 - wp.e) * 0.30102999566398114 + 347;
+	index = (int)dk;
+	if (dk - index > 0.0) {
+		index++;
+	}
+	index = (index >> 3) + 1;
+	*k = -(-348 + index * 8);
+	c = lept_diyfp_make(lept_cached_powers_f[index], lept_cached_powers_e[index]);
+
+	w = lept_diyfp_multiply(lept_diyfp_normalize(v), c);
+	wp = lept_diyfp_multiply(wp, c);
+	wm = lept_diyfp_multiply(wm, c);
+	wm.f++;
+	wp.f--;
+
+	/* 逐位生成 wp 的数字，直到剩余部分落入 delta 范围 */
+	delta = wp.f - wm.f;
+	one = lept_diyfp_make((lept_uint64)1 << -wp.e, wp.e);
+	wp_w = wp.f - w.f;
+	p1 = (unsigned)(wp.f >> -one.e);
+	p2 = wp.f & (one.f - 1);
+	for (kappa = lept_count_decimal_digit(p1); kappa > 0; ) {
+		unsigned digit = p1 / (unsigned)lept_pow10[kappa - 1];
+		p1 %= (unsigned)lept_pow10[kappa - 1];
+		if (digit != 0 || len != 0) {
+			buffer[len++] = (char)('0' + digit);
+		}
+		kappa--;
+		if ((((lept_uint64)p1 << -one.e) + p2) <= delta) {
+			*k += kappa;
+			lept_grisu_round(buffer, len, delta, ((lept_uint64)p1 << -one.e) + p2, lept_pow10[kappa] << -one.e, wp_w);
+			return len;
+		}
+	}
+	for (;;) {
+		unsigned digit;
+		p2 *= 10;
+		delta *= 10;
+		digit = (unsigned)(p2 >> -one.e);
+		if (digit != 0 || len != 0) {
+			buffer[len++] = (char)('0' + digit);
+		}
+		p2 &= one.f - 1;
+		kappa--;
+		if (p2 < delta) {
+			*k += kappa;
+			lept_grisu_round(buffer, len, delta, p2, one.f, -kappa < 20 ? wp_w * lept_pow10[-kappa] : 0);
+			return len;
+		}
+	}
+}
+
+static char* lept_write_exponent(char* p, int e, int es) {
+	/* 与 "%g" 相同，指数带符号且至少两位；es 非 0 时与 ECMAScript 相同，不补 0 */
+	*p++ = 'e';
+	if (e < 0) {
+		*p++ = '-';
+		e = -e;
+	} else {
+		*p++ = '+';
+	}
+	if (e >= 100) {
+		*p++ = (char)('0' + e / 100);
+		e %= 100;
+		*p++ = (char)('0' + e / 10);
+	} else if (e >= 10 || !es) {
+		*p++ = (char)('0' + e / 10);
+	}
+	*p++ = (char)('0' + e % 10);
+	return p;
+}
+
+static int lept_dtoa(double n, char* buffer, int es) {
+	/*
+		buffer 至少 32 字节，返回写入的长度，不写 '\0'。
+		es 非 0 时按 ECMAScript 的 Number.prototype.toString() 输出（RFC 8785）：
+		首位数字的十进制指数小于 -6 或不小于 21 时才用科学计数法，-0 输出 0。
+	*/
+	char digits[20];
+	char* p = buffer;
+	lept_uint64 bits, u;
+	int len, k, exp10, i;
+
+	if (n != n || n - n != n - n) {
+		return sprintf(buffer, "%.17g", n);  /* NaN、Inf 不是合法的 JSON，保持原来的输出 */
+	}
+	memcpy(&bits, &n, sizeof(double));
+	if ((bits >> 63) && !(es && n == 0.0)) {
+		*p++ = '-';
+		n = -n;
+	}
+	/* 整数快速路径：小于 2^53 的整数直接逐位输出 */
+	if (n < 9007199254740992.0 && (double)(u = (lept_uint64)n) == n) {
+		len = 0;
+		do {
+			digits[len++] = (char)('0' + (int)(u % 10));
+			u /= 10;
+		} while (u != 0);
+		while (len > 0) {
+			*p++ = digits[--len];
+		}
+		return (int)(p - buffer);
+	}
+
+	len = lept_grisu2(n, digits, &k);
+	exp10 = len + k - 1;  /* 首位数字的十进制指数 */
+	if (es ? exp10 < -6 || exp10 >= 21 : exp10 < -4 || exp10 >= 17) {
+		*p++ = digits[0];
+		if (len > 1) {
+			*p++ = '.';
+			memcpy(p, digits + 1, len - 1);
+			p += len - 1;
+		}
+		p = lept_write_exponent(p, exp10, es);
+	} else if (k >= 0) {
+		memcpy(p, digits, len);  /* 非整数的路径不会走到这里，除非 >= 2^53 */
+		p += len;
+		for (i = 0; i < k; ++i) {
+			*p++ = '0';
+		}
+	} else if (exp10 >= 0) {
+		memcpy(p, digits, exp10 + 1);
+		p += exp10 + 1;
+		*p++ = '.';
+		memcpy(p, digits + exp10 + 1, len - exp10 - 1);
+		p += len - exp10 - 1;
+	} else {
+		*p++ = '0';
+		*p++ = '.';
+		for (i = -1; i > exp10; --i) {
+			*p++ = '0';
+		}
+		memcpy(p, digits, len);
+		p += len;
+	}
+	return (int)(p - buffer);
+}
+
+static void lept_stringify_number(lept_context* c, double n) {
+	char buffer[32];
+	int len;
+	if (c->write == NULL) {
+		c->top -= 32 - lept_dtoa(n, lept_context_push(c, 32), c->canon != NULL);
+		return;
+	}
+	len = lept_dtoa(n, buffer, c->canon != NULL);  /* 缓冲区大小固定时只压入实际长度，避免提前 flush */
+	PUTS(c, buffer, len);
+}
+
+/*
+	带缩进输出：换行符和若干缩进字符预先拼成一个字符串，换行时按层数截取，
+	层数很深时分段输出。不带缩进时 c->pretty 为 NULL，每个元素只多一次判断。
+*/
+
+#define LEPT_PRETTY_INDENT_SIZE 128
+
+struct lept_pretty {
+	char s[2 + LEPT_PRETTY_INDENT_SIZE];	/* 换行符 + 缩进字符 */
+	size_t newline;		/* 换行符的长度，1 或 2 */
+	size_t indent;		/* 每层的缩进字符数，0 表示不换行 */
+	int space_after_colon;
+};
+
+static void lept_pretty_init(lept_pretty* pretty, const lept_stringify_options* opts) {
+	assert(opts->indent_char == ' ' || opts->indent_char == '\t');
+	pretty->newline = 0;
+	if (opts->crlf) {
+		pretty->s[pretty->newline++] = '\r';
+	}
+	pretty->s[pretty->newline++] = '\n';
+	memset(pretty->s + pretty->newline, opts->indent_char, LEPT_PRETTY_INDENT_SIZE);
+	pretty->indent = opts->indent;
+	pretty->space_after_colon = opts->space_after_colon;
+}
+
+static void lept_stringify_newline(lept_context* c) {
+	const lept_pretty* pretty = c->pretty;
+	size_t n;
+	if (pretty == NULL || pretty->indent == 0) {
+		return;
+	}
+	n = pretty->indent * c->depth;
+	if (n <= LEPT_PRETTY_INDENT_SIZE) {
+		PUTS(c, pretty->s, pretty->newline + n);
+		return;
+	}
+	PUTS(c, pretty->s, pretty->newline);
+	while (n > 0) {
+		size_t m = n < LEPT_PRETTY_INDENT_SIZE ? n : LEPT_PRETTY_INDENT_SIZE;
+		PUTS(c, pretty->s + pretty->newline, m);
+		n -= m;
+	}
+}
+
+/*
+	带缓存的生成：每次生成都给所有值打上 LEPT_FLAG_CACHED，修改函数（包括 lept_free()）会清掉它，
+	并记录每个容器在输出中的位置。没有父指针，所以生成前先遍历一次，
+	自己和所有后代都带标记的容器记入缓存的 hit 表，同时给所有值打上标记；
+	之后的生成过程只读值，hit 表中的容器整段从上一次的输出复制。
+	容器以存储的地址为键，改变存储地址（扩容、改变布局）的函数也要清掉标记，以免地址被复用后认错。
+*/
+#define LEPT_FLAG_CACHED		0x20u	/* 自上次带缓存生成以来没有修改过 */
+#define LEPT_TOUCH(v)			do { (v)->flags &= ~LEPT_FLAG_CACHED; } while (0)
+
+typedef struct {
+	const void* key;	/* 容器存储的地址，NULL 表示空位 */
+	size_t offset, len;
+}lept_cache_entry;
+
+typedef struct {
+	lept_cache_entry* e;
+	size_t size, capacity;	/* capacity 为 0 或 2 的幂，开放寻址 */
+}lept_cache_table;
+
+struct lept_stringify_cache {
+	char* prev;				/* 上一次的输出 */
+	size_t length;
+	lept_cache_table old;	/* 上一次输出中各容器的位置 */
+	lept_cache_table cur;	/* 本次输出中各容器的位置 */
+	lept_cache_table hit;	/* 本次生成前整个子树都没有修改过的容器，只用键 */
+};
+
+static const void* lept_cache_key(const lept_value* v) {
+	if (v->type == LEPT_ARRAY) {
+		return IS_PACKED(v) ? (const void*)v->u.pa.d : IS_SEGMENTED(v) ? (const void*)v->u.sa.b : (const void*)v->u.a.e;
+	}
+	assert(v->type == LEPT_OBJECT);
+	return IS_SHAPED(v) ? (const void*)v->u.so.v : (const void*)v->u.o.m;
+}
+
+static size_t lept_cache_hash(const void* key) {
+	size_t h = (size_t)key >> 4;
+	return h ^ (h >> 7) ^ (h >> 17);
+}
+
+static lept_cache_entry* lept_cache_find(const lept_cache_table* t, const void* key) {
+	size_t i, mask = t->capacity - 1;
+	if (t->capacity == 0) {
+		return NULL;
+	}
+	for (i = lept_cache_hash(key) & mask; t->e[i].key != NULL; i = (i + 1) & mask) {
+		if (t->e[i].key == key) {
+			return &t->e[i];
+		}
+	}
+	return NULL;
+}
+
+static void lept_cache_clear(lept_cache_table* t) {
+	size_t i;
+	for (i = 0; i < t->capacity; ++i) {
+		t->e[i].key = NULL;
+	}
+	t->size = 0;
+}
+
+static void lept_cache_put(lept_cache_table* t, const void* key, size_t offset, size_t len) {
+	size_t i, mask;
+	if (2 * (t->size + 1) > t->capacity) {
+		/* 装载因子不超过 1/2，扩容后重新插入 */
+		lept_cache_table n;
+		n.capacity = t->capacity == 0 ? 64 : 2 * t->capacity;
+		n.e = (lept_cache_entry*)malloc(n.capacity * sizeof(lept_cache_entry));
+		lept_cache_clear(&n);
+		for (i = 0; i < t->capacity; ++i) {
+			if (t->e[i].key != NULL) {
+				lept_cache_put(&n, t->e[i].key, t->e[i].offset, t->e[i].len);
+			}
+		}
+		free(t->e);
+		*t = n;
+	}
+	mask = t->capacity - 1;
+	for (i = lept_cache_hash(key) & mask; t->e[i].key != NULL && t->e[i].key != key; i = (i + 1) & mask);
+	if (t->e[i].key == NULL) {
+		++t->size;
+	}
+	t->e[i].key = key;
+	t->e[i].offset = offset;
+	t->e[i].len = len;
+}
+
+static int lept_cache_check(lept_stringify_cache* cache, lept_value* v) {
+	/* 子节点总要全部访问，接下来的输出就是它们当前的内容，所以都打上 LEPT_FLAG_CACHED */
+	size_t i, size;
+	int hit = (v->flags & LEPT_FLAG_CACHED) != 0;
+	const void* key;
+	v->flags |= LEPT_FLAG_CACHED;
+	if (v->type == LEPT_ARRAY) {
+		if (!IS_PACKED(v)) {
+			for (i = 0, size = lept_get_array_size(v); i < size; ++i) {
+				hit &= lept_cache_check(cache, lept_array_at(v, i));
+			}
+		}
+	} else if (v->type == LEPT_OBJECT) {
+		for (i = 0, size = lept_get_object_size(v); i < size; ++i) {
+			hit &= lept_cache_check(cache, lept_get_object_value(v, i));
+		}
+	} else {
+		return hit;
+	}
+	if (hit && (key = lept_cache_key(v)) != NULL) {
+		lept_cache_put(&cache->hit, key, 0, 0);
+	}
+	return hit;
+}
+
+static void lept_cache_carry(lept_stringify_cache* cache, const lept_value* v, size_t old_offset, size_t new_offset) {
+	/* 整段复制后，其中各后代容器的位置随之平移（size_t 的回绕保证相减为负时也正确） */
+	size_t i, size;
+	const lept_value* e;
+	const lept_cache_entry* entry;
+	if (v->type == LEPT_ARRAY && IS_PACKED(v)) {
+		return;
+	}
+	size = v->type == LEPT_ARRAY ? lept_get_array_size(v) : lept_get_object_size(v);
+	for (i = 0; i < size; ++i) {
+		e = v->type == LEPT_ARRAY ? lept_array_at(v, i) : lept_get_object_value(v, i);
+		if (e->type != LEPT_ARRAY && e->type != LEPT_OBJECT) {
+			continue;
+		}
+		if ((entry = lept_cache_find(&cache->old, lept_cache_key(e))) != NULL) {
+			lept_cache_put(&cache->cur, entry->key, entry->offset - old_offset + new_offset, entry->len);
+		}
+		lept_cache_carry(cache, e, old_offset, new_offset);
+	}
+}
+
+static int lept_cache_reuse(lept_context* c, const lept_value* v) {
+	const lept_cache_entry* entry;
+	const void* key;
+	size_t offset = c->top;
+	if (v->type != LEPT_ARRAY && v->type != LEPT_OBJECT) {
+		return 0;
+	}
+	if ((key = lept_cache_key(v)) == NULL) {
+		return 0;  /* 空容器没有存储，重新生成 */
+	}
+	if (lept_cache_find(&c->cache->hit, key) == NULL || (entry = lept_cache_find(&c->cache->old, key)) == NULL) {
+		return 0;
+	}
+	PUTS(c, c->cache->prev + entry->offset, entry->len);
+	lept_cache_put(&c->cache->cur, entry->key, offset, entry->len);
+	lept_cache_carry(c->cache, v, entry->offset, offset);
+	return 1;
+}
+
+static void lept_cache_store(lept_context* c, const lept_value* v, size_t offset) {
+	const void* key;
+	if ((v->type == LEPT_ARRAY || v->type == LEPT_OBJECT) && (key = lept_cache_key(v)) != NULL) {
+		lept_cache_put(&c->cache->cur, key, offset, c->top - offset);
+	}
+}
+
+static void lept_stringify_key(lept_context* c, const lept_value* v, size_t index) {
+	if (IS_SHAPED(v) && v->u.so.shape->list->keys[index].clean) {
+		lept_stringify_clean_string(c, lept_get_object_key(v, index), lept_get_object_key_length(v, index));
+	} else {
+		lept_stringify_string(c, lept_get_object_key(v, index), lept_get_object_key_length(v, index));
+	}
+}
+
+/*
+	规范形式（RFC 8785）：对象的键按 UTF-16 码元排序，数字按 ECMAScript 的规则输出，
+	转义只用必需的几种，\u 后用小写十六进制。排序只对键的指针排序，不复制值，
+	各层对象共用一个按栈使用的排序区，已经有序的对象不调用 qsort()。
+*/
+
+typedef struct {
+	const char* k;
+	size_t klen;
+	size_t index;	/* 在对象中的下标 */
+}lept_canon_member;
+
+struct lept_canon {
+	lept_canon_member* m;
+	size_t top, capacity;
+};
+
+static unsigned long lept_utf16_order(const char* s, size_t len) {
+	/* 解码开头的 UTF-8 字符，返回按 UTF-16 码元比较的键：高 16 位是第一个码元，增补平面的字符低 16 位是第二个码元 */
+	const unsigned char* p = (const unsigned char*)s;
+	unsigned long u;
+	unsigned char b1 = len > 1 ? p[1] : 0, b2 = len > 2 ? p[2] : 0, b3 = len > 3 ? p[3] : 0;
+	if (p[0] < 0xC0) {
+		return (unsigned long)p[0] << 16;
+	}
+	if (p[0] < 0xE0) {
+		return (((unsigned long)(p[0] & 0x1F) << 6) | (b1 & 0x3F)) << 16;
+	}
+	if (p[0] < 0xF0) {
+		return (((unsigned long)(p[0] & 0x0F) << 12) | ((unsigned long)(b1 & 0x3F) << 6) | (b2 & 0x3F)) << 16;
+	}
+	u = ((unsigned long)(p[0] & 0x07) << 18) | ((unsigned long)(b1 & 0x3F) << 12) | ((unsigned long)(b2 & 0x3F) << 6) | (b3 & 0x3F);
+	u -= 0x10000;
+	return ((0xD800 + (u >> 10)) << 16) | (0xDC00 + (u & 0x3FF));
+}
+
+static int lept_canon_compare(const void* a, const void* b) {
+	/* UTF-8 按字节比较与按码点比较相同，只有第一个不同的字符要换算成 UTF-16 码元再比较 */
+	const lept_canon_member* x = (const lept_canon_member*)a;
+	const lept_canon_member* y = (const lept_canon_member*)b;
+	size_t i, n = x->klen < y->klen ? x->klen : y->klen;
+	unsigned long ux, uy;
+	for (i = 0; i < n && x->k[i] == y->k[i]; ++i);
+	if (i == n) {
+		return x->klen < y->klen ? -1 : x->klen > y->klen;
+	}
+	while (i > 0 && ((unsigned char)x->k[i] & 0xC0) == 0x80) {
+		--i;  /* 退回到这个字符的首字节，前面的字节两者相同 */
+	}
+	ux = lept_utf16_order(x->k + i, x->klen - i);
+	uy = lept_utf16_order(y->k + i, y->klen - i);
+	return ux < uy ? -1 : ux > uy;
+}
+
+static void lept_stringify_value(lept_context* c, const lept_value* v);  /* 前向声明 */
+
+static void lept_stringify_canonical_object(lept_context* c, const lept_value* v) {
+	lept_canon* canon = c->canon;
+	size_t i, size = lept_get_object_size(v), base = canon->top;
+	lept_canon_member* m;
+	int sorted = 1;
+	if (base + size > canon->capacity) {
+		canon->capacity = base + size > 2 * canon->capacity ? base + size : 2 * canon->capacity;
+		canon->m = (lept_canon_member*)realloc(canon->m, canon->capacity * sizeof(lept_canon_member));
+	}
+	m = canon->m + base;
+	for (i = 0; i < size; ++i) {
+		m[i].k = lept_get_object_key(v, i);
+		m[i].klen = lept_get_object_key_length(v, i);
+		m[i].index = i;
+		if (sorted && i > 0 && lept_canon_compare(&m[i - 1], &m[i]) > 0) {
+			sorted = 0;
+		}
+	}
+	if (!sorted) {
+		qsort(m, size, sizeof(lept_canon_member), lept_canon_compare);
+	}
+	canon->top += size;
+	PUTC(c, '{');
+	for (i = 0; i < size; ++i) {
+		size_t index = canon->m[base + i].index;  /* 生成子对象时排序区可能 realloc，每次重新取 */
+		if (i > 0) {
+			PUTC(c, ',');
+		}
+		lept_stringify_key(c, v, index);
+		PUTC(c, ':');
+		lept_stringify_value(c, lept_get_object_value(v, index));
+	}
+	PUTC(c, '}');
+	canon->top = base;
+}
+
+static void lept_stringify_members(lept_context* c, const lept_value* v, size_t from, size_t to) {
+	/* 生成数组元素或对象成员 [from, to)，不含括号，除了第 0 个之外每个前面都有逗号 */
+	size_t i;
+	for (i = from; i < to && c->error == 0; ++i) {
+		if (i > 0) {
+			PUTC(c, ',');
+		}
+		lept_stringify_newline(c);
+		if (v->type == LEPT_ARRAY) {
+			if (IS_PACKED(v)) {
+				lept_stringify_number(c, v->u.pa.d[i]);
+			} else {
+				lept_stringify_value(c, lept_array_at(v, i));
+			}
+			continue;
+		}
+		lept_stringify_key(c, v, i);
+		PUTC(c, ':');
+		if (c->pretty != NULL && c->pretty->space_after_colon) {
+			PUTC(c, ' ');
+		}
+		lept_stringify_value(c, lept_get_object_value(v, i));
+	}
+}
+
+static void lept_stringify_parallel_members(lept_context* c, const lept_value* v, size_t size);  /* 前向声明 */
+
+static void lept_stringify_children(lept_context* c, const lept_value* v, size_t size) {
+	if (c->parallel != NULL) {
+		lept_stringify_parallel_members(c, v, size);
+	} else {
+		lept_stringify_members(c, v, 0, size);
+	}
+}
+
+static void lept_stringify_value(lept_context* c, const lept_value* v) {
+	size_t size, offset = c->top;
+	if (c->cache != NULL && lept_cache_reuse(c, v)) {
+		return;
+	}
+	switch (v->type) {
+		case LEPT_NULL:		PUTS(c, "null", 4); break;
+		case LEPT_FALSE:	PUTS(c, "false", 5); break;
+		case LEPT_TRUE:		PUTS(c, "true", 4); break;
+		case LEPT_NUMBER:	lept_stringify_number(c, v->u.n); break;
+		case LEPT_STRING:
+			if (v->flags & LEPT_FLAG_CLEAN) {
+				lept_stringify_clean_string(c, v->u.s.s, v->u.s.len);
+			} else {
+				lept_stringify_string(c, v->u.s.s, v->u.s.len);
+			}
+			break;
+		case LEPT_ARRAY:
+			PUTC(c, '[');
+			if ((size = lept_get_array_size(v)) == 0) {
+				PUTC(c, ']');  /* 空数组不换行 */
+				break;
+			}
+			++c->depth;
+			lept_stringify_children(c, v, size);
+			--c->depth;
+			lept_stringify_newline(c);
+			PUTC(c, ']');
+			break;
+		case LEPT_OBJECT:
+			if (c->canon != NULL) {
+				lept_stringify_canonical_object(c, v);
+				break;
+			}
+			PUTC(c, '{');
+			if ((size = lept_get_object_size(v)) == 0) {
+				PUTC(c, '}');
+				break;
+			}
+			++c->depth;
+			lept_stringify_children(c, v, size);
+			--c->depth;
+			lept_stringify_newline(c);
+			PUTC(c, '}');
+			break;
+		default:			assert(0 && "invalid type");
+	}
+	if (c->cache != NULL) {
+		lept_cache_store(c, v, offset);
+	}
+}
+
+static void lept_stringify_init(lept_context* c, char* stack, size_t size) {
+	c->stack = stack;
+	c->size = size;
+	c->top = 0;
+	c->write = NULL;
+	c->ud = NULL;
+	c->error = 0;
+	c->pretty = NULL;
+	c->depth = 0;
+	c->iov = NULL;
+	c->cache = NULL;
+	c->canon = NULL;
+	c->parallel = NULL;
+}
+
+char* lept_stringify(const lept_value* v, size_t* length) {
+	lept_context c;
+	assert(v != NULL);
+	lept_stringify_init(&c, (char*)malloc(LEPT_PARSE_STRINGIFY_INIT_SIZE), LEPT_PARSE_STRINGIFY_INIT_SIZE);
+	lept_stringify_value(&c, v);
+	if (length) {
+		*length = c.top;
+	}
+	PUTC(&c, '\0');
+	return c.stack;
+}
+
+char* lept_stringify_ex(const lept_value* v, const lept_stringify_options* opts, size_t* length) {
+	lept_context c;
+	lept_pretty pretty;
+	assert(v != NULL);
+	if (opts == NULL) {
+		return lept_stringify(v, length);
+	}
+	lept_pretty_init(&pretty, opts);
+	lept_stringify_init(&c, (char*)malloc(LEPT_PARSE_STRINGIFY_INIT_SIZE), LEPT_PARSE_STRINGIFY_INIT_SIZE);
+	c.pretty = &pretty;
+	lept_stringify_value(&c, v);
+	if (length) {
+		*length = c.top;
+	}
+	PUTC(&c, '\0');
+	return c.stack;
+}
+
+/*
+	词法级的扫描：不建立 lept_value 树，按 lept_parse() 的语法和错误码检查 JSON，
+	同时把字符串、数字等词法单元原样复制到 s->c（为 NULL 时只检查），空白按 c->pretty 重新生成。
+	不递归，每层是数组还是对象记在固定大小的位栈里，除了输出不分配内存。
+	字符串中不需要处理的片段用 lept_scan_clean() 成块跳过。
+*/
+
+#ifndef LEPT_SCAN_MAX_DEPTH
+#define LEPT_SCAN_MAX_DEPTH 1024	/* 扫描时的最大嵌套层数，超过时返回 LEPT_PARSE_TOO_DEEP */
+#endif
+
+typedef struct {
+	const char* json;	/* 当前位置，出错时停在出错处 */
+	const char* end;
+	lept_context* c;	/* 输出，NULL 表示只检查 */
+	int partial;		/* 为 1 时只扫描一个值，不检查之后的内容 */
+}lept_scanner;
+
+#define ISWHITESPACE(ch)		((ch) == ' ' || (ch) == '\t' || (ch) == '\n' || (ch) == '\r')
+#define SCAN_WHITESPACE(p, end)	((p) = lept_scan_whitespace(p, end))
+
+static const char* lept_scan_whitespace(const char* p, const char* end) {
+	/* 多数位置没有空白或只有一两个，先逐个判断；缩进等较长的空白再交给 SIMD 内核 */
+	int i;
+	for (i = 0; i < 4; ++i, ++p) {
+		if (p == end || !ISWHITESPACE(*p)) {
+			return p;
+		}
+	}
+	return lept_skip_whitespace(p, end);
+}
+#define SCAN_PUTC(s, ch)		do { if ((s)->c != NULL) PUTC((s)->c, ch); } while (0)
+#define SCAN_ERROR(s, p, ret)	do { (s)->json = (p); return ret; } while (0)
+
+static int lept_scan_number_too_big(const char* p, const char* end) {
+	/*
+		[p, end) 是合法的数字。首位有效数字的十进制指数不是 308 时可以直接判断，
+		是 308 时取前 40 位有效数字拼成一个较短的数字交给 strtod()，输入不以 '\0' 结尾也没关系。
+	*/
+	char buffer[64];
+	char* q = buffer;
+	const char* int_end;
+	long e10, exp = 0;
+	int n = 0, exp_neg = 0;
+	double d;
+	if (*p == '-') {
+		*q++ = *p++;
+	}
+	for (int_end = p; int_end < end && ISDIGIT(*int_end); ++int_end);
+	e10 = (long)(int_end - p) - 1;
+	for (; p < end && (*p == '0' || *p == '.'); ++p) {
+		if (*p == '0') {
+			--e10;  /* 前导 0 */
+		}
+	}
+	if (p == end || !ISDIGIT(*p)) {
+		return 0;  /* 值为 0 */
+	}
+	for (; p < end && (ISDIGIT(*p) || *p == '.'); ++p) {
+		if (*p != '.' && n++ < 40) {
+			*q++ = *p;
+			if (n == 1) {
+				*q++ = '.';
+			}
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		if (*p == '+' || *p == '-') {
+			exp_neg = *p++ == '-';
+		}
+		for (; p < end && ISDIGIT(*p); ++p) {
+			if (exp < 100000) {
+				exp = exp * 10 + (*p - '0');
+			}
+		}
+	}
+	e10 += exp_neg ? -exp : exp;
+	if (e10 != 308) {
+		return e10 > 308;
+	}
+	sprintf(q, "e%ld", e10);
+	errno = 0;
+	d = strtod(buffer, NULL);
+	return errno == ERANGE && (d == HUGE_VAL || d == -HUGE_VAL);
+}
+
+static int lept_scan_number(lept_scanner* s) {
+	const char* p = s->json;
+	const char* end = s->end;
+	if (p < end && *p == '-') {
+		++p;
+	}
+	if (p < end && *p == '0') {
+		++p;
+	} else {
+		if (p == end || !ISDIGIT1TO9(*p)) {
+			return LEPT_PARSE_INVALID_VALUE;
+		}
+		for (++p; p < end && ISDIGIT(*p); ++p);
+	}
+	if (p < end && *p == '.') {
+		++p;
+		if (p == end || !ISDIGIT(*p)) {
+			return LEPT_PARSE_INVALID_VALUE;
+		}
+		for (++p; p < end && ISDIGIT(*p); ++p);
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		if (p < end && (*p == '+' || *p == '-')) {
+			++p;
+		}
+		if (p == end || !ISDIGIT(*p)) {
+			return LEPT_PARSE_INVALID_VALUE;
+		}
+		for (++p; p < end && ISDIGIT(*p); ++p);
+	}
+	if (lept_scan_number_too_big(s->json, p)) {
+		return LEPT_PARSE_NUMBER_TOO_BIG;
+	}
+	if (s->c != NULL) {
+		lept_context_write(s->c, s->json, (size_t)(p - s->json));
+	}
+	s->json = p;
+	return LEPT_PARSE_OK;
+}
+
+static int lept_scan_string(lept_scanner* s) {
+	/* 错误码的判断顺序与 lept_parse_string_raw() 相同 */
+	const char* p = s->json + 1;
+	const char* end = s->end;
+	unsigned u;
+	assert(*s->json == '"');
 	for (;;) {
-		/*
-			如果此处写成以下代码，就会出现 bug：
-			lept_value* e = lept_context_push(c, sizeof(lept_value));
-			lept_init(e);
-			size++;
-			if ((ret = lept_parse_value(c, e)) != LEPT_PARSE_OK)
-				return ret;
-			原因：e 是一个指向堆区的指针，当我们的栈满的时候，就会自动扩容，原来的一片空间可能
-			就到其他地方去了，而 e 仍然指向原来的位置，成为悬空指针。
-		*/
-		lept_value e;
-		lept_init(&e);
-		if ((ret = lept_parse_value(c, &e)) != LEPT_PARSE_OK) {
-			break;  /* 解析失败，堆栈中会存入这些非法值，在返回之前应当清空 */
+		p += lept_scan_clean(p, (size_t)(end - p));
+		if (p == end || *p == '\0') {
+			SCAN_ERROR(s, p, LEPT_PARSE_MISS_QUOTATION_MARK);
 		}
-		memcpy(lept_context_push(c, sizeof(lept_value)), &e, sizeof(lept_value));
-		++size;
-		lept_parse_whitespace(c);
-		if (*c->json == ',') {
-			++c->json;
-			lept_parse_whitespace(c);
-		} else if (*c->json == ']') {
-			++c->json;
-			lept_set_array(v, size);
-			memcpy(v->u.a.e, lept_context_pop(c, size * sizeof(lept_value)), size * sizeof(lept_value));
-			v->u.a.size = size;
+		if (*p == '"') {
+			break;
+		}
+		if (*p != '\\') {
+			SCAN_ERROR(s, p, LEPT_PARSE_INVALID_STRING_CHAR);
+		}
+		if (++p == end) {
+			SCAN_ERROR(s, p, LEPT_PARSE_INVALID_STRING_ESCAPE);
+		}
+		switch (*p++) {
+			case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+				break;
+			case 'u':
+				if (end - p < 4 || lept_parse_hex4(p, &u) == NULL) {
+					SCAN_ERROR(s, p - 1, LEPT_PARSE_INVALID_UNICODE_HEX);
+				}
+				p += 4;
+				if (u >= 0xD800 && u <= 0xDBFF) {
+					if (p == end || *p != '\\') {
+						SCAN_ERROR(s, p, LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+					}
+					if (++p == end || *p != 'u') {
+						SCAN_ERROR(s, p, LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+					}
+					if (end - ++p < 4 || lept_parse_hex4(p, &u) == NULL) {
+						SCAN_ERROR(s, p - 1, LEPT_PARSE_INVALID_UNICODE_HEX);
+					}
+					p += 4;
+					if (u < 0xDC00 || u > 0xDFFF) {
+						SCAN_ERROR(s, p - 1, LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+					}
+				}
+				break;
+			default:
+				SCAN_ERROR(s, p - 1, LEPT_PARSE_INVALID_STRING_ESCAPE);
+		}
+	}
+	++p;
+	if (s->c != NULL) {
+		lept_context_write(s->c, s->json, (size_t)(p - s->json));
+	}
+	s->json = p;
+	return LEPT_PARSE_OK;
+}
+
+static int lept_scan_literal(lept_scanner* s, const char* literal, size_t len) {
+	size_t i;
+	for (i = 1; i < len; ++i) {
+		if (s->json + i == s->end || s->json[i] != literal[i]) {
+			SCAN_ERROR(s, s->json + i, LEPT_PARSE_INVALID_VALUE);  /* 与 lept_parse_literal() 一样停在不匹配处 */
+		}
+	}
+	if (s->c != NULL) {
+		PUTS(s->c, literal, len);
+	}
+	s->json += len;
+	return LEPT_PARSE_OK;
+}
+
+static int lept_scan(lept_scanner* s) {
+	unsigned char objects[LEPT_SCAN_MAX_DEPTH / 8];	/* 第 i 位为 1 表示第 i 层是对象 */
+	size_t depth = 0;
+	const char* p = s->json;
+	const char* end = s->end;
+	int ret;
+#define SCAN_IN_OBJECT()	((objects[(depth - 1) >> 3] >> ((depth - 1) & 7)) & 1)
+#define SCAN_NEWLINE()		do { if (s->c != NULL && s->c->pretty != NULL) { s->c->depth = depth; lept_stringify_newline(s->c); } } while (0)
+	SCAN_WHITESPACE(p, end);
+	for (;;) {
+		/* 值 */
+		if (p == end) {
+			SCAN_ERROR(s, p, LEPT_PARSE_EXPECT_VALUE);
+		}
+		switch (*p) {
+			case '[':
+			case '{':
+				SCAN_PUTC(s, *p);
+				if (depth == LEPT_SCAN_MAX_DEPTH) {
+					SCAN_ERROR(s, p, LEPT_PARSE_TOO_DEEP);
+				}
+				if (*p == '{') {
+					objects[depth >> 3] |= (unsigned char)(1u << (depth & 7));
+				} else {
+					objects[depth >> 3] &= (unsigned char)~(1u << (depth & 7));
+				}
+				++depth;
+				++p;
+				SCAN_WHITESPACE(p, end);
+				if (p < end && *p == (SCAN_IN_OBJECT() ? '}' : ']')) {
+					SCAN_PUTC(s, *p);  /* 空容器不换行 */
+					--depth;
+					s->json = p + 1;
+					ret = LEPT_PARSE_OK;
+					break;
+				}
+				SCAN_NEWLINE();
+				if (!SCAN_IN_OBJECT()) {
+					continue;
+				}
+				goto key;
+			case '"':  s->json = p; ret = lept_scan_string(s); break;
+			case 't':  s->json = p; ret = lept_scan_literal(s, "true", 4); break;
+			case 'f':  s->json = p; ret = lept_scan_literal(s, "false", 5); break;
+			case 'n':  s->json = p; ret = lept_scan_literal(s, "null", 4); break;
+			case '\0': SCAN_ERROR(s, p, LEPT_PARSE_EXPECT_VALUE);
+			default:   s->json = p; ret = lept_scan_number(s); break;
+		}
+		if (ret != LEPT_PARSE_OK) {
+			return ret;
+		}
+		p = s->json;
+		/* 值之后：逗号、右括号，或者根值结束 */
+		for (;;) {
+			if (depth == 0 && s->partial) {
+				s->json = p;
+				return LEPT_PARSE_OK;
+			}
+			SCAN_WHITESPACE(p, end);
+			if (depth == 0) {
+				if (p != end) {
+					SCAN_ERROR(s, p, LEPT_PARSE_ROOT_NOT_SINGULAR);
+				}
+				s->json = p;
+				return LEPT_PARSE_OK;
+			}
+			if (p < end && *p == ',') {
+				SCAN_PUTC(s, ',');
+				++p;
+				SCAN_WHITESPACE(p, end);
+				SCAN_NEWLINE();
+				break;
+			}
+			if (p < end && *p == (SCAN_IN_OBJECT() ? '}' : ']')) {
+				--depth;
+				SCAN_NEWLINE();
+				SCAN_PUTC(s, *p);
+				++p;
+				continue;
+			}
+			SCAN_ERROR(s, p, SCAN_IN_OBJECT() ? LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET);
+		}
+		if (!SCAN_IN_OBJECT()) {
+			continue;
+		}
+	key:
+		/* 对象的键和冒号 */
+		if (p == end || *p != '"') {
+			SCAN_ERROR(s, p, LEPT_PARSE_MISS_KEY);
+		}
+		s->json = p;
+		if ((ret = lept_scan_string(s)) != LEPT_PARSE_OK) {
+			return ret;
+		}
+		p = s->json;
+		SCAN_WHITESPACE(p, end);
+		if (p == end || *p != ':') {
+			SCAN_ERROR(s, p, LEPT_PARSE_MISS_COLON);
+		}
+		SCAN_PUTC(s, ':');
+		if (s->c != NULL && s->c->pretty != NULL && s->c->pretty->space_after_colon) {
+			PUTC(s->c, ' ');
+		}
+		++p;
+		SCAN_WHITESPACE(p, end);
+	}
+#undef SCAN_IN_OBJECT
+#undef SCAN_NEWLINE
+}
+
+int lept_validate(const char* json, size_t len, size_t* err_offset) {
+	lept_scanner s;
+	int ret;
+	assert(json != NULL);
+	s.json = json;
+	s.end = json + len;
+	s.c = NULL;
+	s.partial = 0;
+	if ((ret = lept_scan(&s)) != LEPT_PARSE_OK && err_offset != NULL) {
+		*err_offset = (size_t)(s.json - json);
+	}
+	return ret;
+}
+
+static int lept_skip_unchecked(lept_scanner* s) {
+	/* 不检查语法，只匹配引号和括号：字符串用 lept_scan_clean() 跳到引号或反斜杠，容器用 lept_scan_structural() 跳到下一个括号或引号 */
+	const char* p = s->json;
+	const char* end = s->end;
+	size_t depth = 0;
+	SCAN_WHITESPACE(p, end);
+	if (p == end || *p == '\0') {
+		SCAN_ERROR(s, p, LEPT_PARSE_EXPECT_VALUE);
+	}
+	if (*p != '"' && *p != '[' && *p != '{') {
+		/* 数字和字面量到分隔符为止 */
+		const char* q = p;
+		while (p < end && *p != ',' && *p != ']' && *p != '}' && !ISWHITESPACE(*p)) {
+			++p;
+		}
+		if (p == q) {
+			SCAN_ERROR(s, p, LEPT_PARSE_INVALID_VALUE);
+		}
+		s->json = p;
+		return LEPT_PARSE_OK;
+	}
+	s->json = p;
+	for (;;) {
+		switch (*p) {
+			case '"':
+				for (++p;;) {
+					p += lept_scan_clean(p, (size_t)(end - p));
+					if (p == end) {
+						SCAN_ERROR(s, p, LEPT_PARSE_MISS_QUOTATION_MARK);
+					}
+					if (*p == '"') {
+						break;
+					}
+					p += *p == '\\' && end - p >= 2 ? 2 : 1;  /* 跳过转义的字符，控制字符不检查 */
+				}
+				break;
+			case '[':
+			case '{':
+				++depth;
+				break;
+			default:  /* ']' 或 '}'，不检查是否与左括号配对 */
+				--depth;
+				break;
+		}
+		++p;
+		if (depth == 0) {
+			s->json = p;
 			return LEPT_PARSE_OK;
-		} else {
-			ret = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
-			break;  /* 解析失败，堆栈中会存入非法值之前的合法值，在返回之前应当清空 */
 		}
+		p += lept_scan_structural(p, (size_t)(end - p));
+		if (p == end) {
+			int ret = *s->json == '{' ? LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;  /* 按最外层的括号 */
+			SCAN_ERROR(s, p, ret);
+		}
+	}
+}
+
+int lept_skip_value(const char* json, size_t len, int validate, size_t* offset) {
+	lept_scanner s;
+	int ret;
+	assert(json != NULL && offset != NULL);
+	s.json = json;
+	s.end = json + len;
+	s.c = NULL;
+	s.partial = 1;
+	ret = validate ? lept_scan(&s) : lept_skip_unchecked(&s);
+	*offset = (size_t)(s.json - json);
+	return ret;
+}
+
+int lept_minify(const char* json, size_t len, char* out, size_t* length) {
+	lept_context c;
+	lept_scanner s;
+	int ret;
+	assert(json != NULL && out != NULL);
+	lept_stringify_init(&c, out, len + 2);  /* 输出不会比输入长，加上 '\0' 也放得下，stack 不会扩容 */
+	s.json = json;
+	s.end = json + len;
+	s.c = &c;
+	s.partial = 0;
+	if ((ret = lept_scan(&s)) == LEPT_PARSE_OK) {
+		if (length) {
+			*length = c.top;
+		}
+		PUTC(&c, '\0');
 	}
-	for (i = 0; i < size; ++i) {
-		lept_free((lept_value*)lept_context_pop(c, sizeof(lept_value)));
-	}
+	assert(c.stack == out);
 	return ret;
-	/*
-		如果当解析数组时，第一个元素就出现错误，如果第一个元素是 null 或者数字等，
-		因为没有将保存数字的 lept_value 放在堆上，解析的时候也没有利用堆，所以不需要额外处理。
-		但是如果第一个元素是一个字符串，这个字符串前面一部分都合法，结尾时不合法，
-		那么前面的这一部分字符会先在堆上开辟一部分空间，然后把它们存进去，但是当遇到非法字符时，
-		就会调用 STRING_ERROR 来使得 c->top 回到一开始的地点，栈空间虽然变大了，
-		但 c-> top 回到了原来的地方，相当于并没有占用栈空间（这部分空间后面仍然可以用），
-		这部分的空间会在 lept_parse 的最后一起释放。
-	*/
 }
 
-static int lept_parse_object(lept_context* c, lept_value* v) {
-	size_t i, size;
-	lept_member m;
+int lept_reformat(const char* json, size_t len, const lept_stringify_options* opts, char** out, size_t* length) {
+	lept_context c;
+	lept_pretty pretty;
+	lept_scanner s;
 	int ret;
-	EXPECT(c, '{');
-	lept_parse_whitespace(c);
-	if (*c->json == '}') {
-		++c->json;
-		lept_set_object(v, 0);
-		return LEPT_PARSE_OK;
+	assert(json != NULL && out != NULL);
+	lept_stringify_init(&c, (char*)malloc(len + LEPT_PARSE_STRINGIFY_INIT_SIZE), len + LEPT_PARSE_STRINGIFY_INIT_SIZE);
+	if (opts != NULL) {
+		lept_pretty_init(&pretty, opts);
+		c.pretty = &pretty;
 	}
-	m.k = NULL;
-	size = 0;
-	for (;;) {
-		char* str;
-		lept_init(&m.v);
-		/* 解析 key */
-		if (*c->json != '"') {
-			ret = LEPT_PARSE_MISS_KEY;
-			break;
+	s.json = json;
+	s.end = json + len;
+	s.c = &c;
+	s.partial = 0;
+	if ((ret = lept_scan(&s)) != LEPT_PARSE_OK) {
+		free(c.stack);
+		*out = NULL;
+		return ret;
+	}
+	if (length) {
+		*length = c.top;
+	}
+	PUTC(&c, '\0');
+	*out = c.stack;
+	return LEPT_PARSE_OK;
+}
+
+/*
+	并行生成：元素很多的数组或对象按个数分成若干段，各段由工作线程生成到自己的缓冲区，
+	主线程生成第一段，然后按顺序把其余各段接在后面，结果与串行生成逐字节相同。
+	工作线程的 context 不再拆分，所以只有从根往下遇到的第一层大容器会并行，小的子树都是串行的。
+	生成只读值树，不写任何标记，各线程共用同一个树也不需要加锁。
+*/
+
+#ifndef LEPT_PARALLEL_MIN_CHILDREN
+#define LEPT_PARALLEL_MIN_CHILDREN 1024	/* 元素少于此数的容器串行生成 */
+#endif
+
+#ifndef LEPT_PARALLEL_MAX_THREADS
+#define LEPT_PARALLEL_MAX_THREADS 64
+#endif
+
+struct lept_parallel {
+	unsigned threads;
+	size_t min_children;
+};
+
+typedef struct {
+	const lept_value* v;
+	size_t from, to;
+	lept_context c;
+}lept_parallel_task;
+
+#if defined(LEPT_NO_THREADS)
+#elif defined(_WIN32)
+static DWORD WINAPI lept_parallel_worker(LPVOID arg) {
+	lept_parallel_task* t = (lept_parallel_task*)arg;
+	lept_stringify_members(&t->c, t->v, t->from, t->to);
+	return 0;
+}
+#else
+static void* lept_parallel_worker(void* arg) {
+	lept_parallel_task* t = (lept_parallel_task*)arg;
+	lept_stringify_members(&t->c, t->v, t->from, t->to);
+	return NULL;
+}
+#endif
+
+static void lept_stringify_parallel_members(lept_context* c, const lept_value* v, size_t size) {
+	lept_parallel_task tasks[LEPT_PARALLEL_MAX_THREADS];
+	int started[LEPT_PARALLEL_MAX_THREADS];
+#if defined(LEPT_NO_THREADS)
+#elif defined(_WIN32)
+	HANDLE threads[LEPT_PARALLEL_MAX_THREADS];
+#else
+	pthread_t threads[LEPT_PARALLEL_MAX_THREADS];
+#endif
+	const lept_parallel* parallel;
+	unsigned i, n = c->parallel->threads;
+	assert(n >= 2 && n <= LEPT_PARALLEL_MAX_THREADS);
+	if (size < c->parallel->min_children) {
+		lept_stringify_members(c, v, 0, size);  /* 小容器串行生成，其中的大容器仍可拆分 */
+		return;
+	}
+	for (i = 1; i < n; ++i) {
+		lept_parallel_task* t = &tasks[i];
+		t->v = v;
+		t->from = size / n * i;
+		t->to = i + 1 == n ? size : size / n * (i + 1);
+		lept_stringify_init(&t->c, (char*)malloc(LEPT_PARSE_STRINGIFY_INIT_SIZE), LEPT_PARSE_STRINGIFY_INIT_SIZE);
+		t->c.pretty = c->pretty;
+		t->c.depth = c->depth;
+#if defined(LEPT_NO_THREADS)
+		started[i] = 0;
+#elif defined(_WIN32)
+		started[i] = (threads[i] = CreateThread(NULL, 0, lept_parallel_worker, t, 0, NULL)) != NULL;
+#else
+		started[i] = pthread_create(&threads[i], NULL, lept_parallel_worker, t) == 0;
+#endif
+	}
+	parallel = c->parallel;
+	c->parallel = NULL;  /* 与工作线程一样，第一段里的容器不再拆分 */
+	lept_stringify_members(c, v, 0, size / n);
+	c->parallel = parallel;
+	for (i = 1; i < n; ++i) {
+		lept_parallel_task* t = &tasks[i];
+		if (started[i]) {
+#if defined(LEPT_NO_THREADS)
+#elif defined(_WIN32)
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+#else
+			pthread_join(threads[i], NULL);
+#endif
+		} else {
+			lept_stringify_members(&t->c, v, t->from, t->to);  /* 线程创建失败时在主线程生成 */
 		}
-		if ((ret = lept_parse_string_raw(c, &str, &m.klen)) != LEPT_PARSE_OK) {
-			break;
+		lept_context_write(c, t->c.stack, t->c.top);
+		free(t->c.stack);
+	}
+}
+
+static unsigned lept_cpu_count(void) {
+#if defined(LEPT_NO_THREADS)
+	return 1;
+#elif defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (unsigned)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (unsigned)n : 1;
+#else
+	return 1;
+#endif
+}
+
+char* lept_stringify_parallel(const lept_value* v, unsigned threads, size_t* length) {
+	lept_context c;
+	lept_parallel parallel;
+	assert(v != NULL);
+	parallel.threads = threads == 0 ? lept_cpu_count() : threads;
+	if (parallel.threads > LEPT_PARALLEL_MAX_THREADS) {
+		parallel.threads = LEPT_PARALLEL_MAX_THREADS;
+	}
+	parallel.min_children = LEPT_PARALLEL_MIN_CHILDREN;
+	lept_stringify_init(&c, (char*)malloc(LEPT_PARSE_STRINGIFY_INIT_SIZE), LEPT_PARSE_STRINGIFY_INIT_SIZE);
+	if (parallel.threads > 1) {
+		c.parallel = &parallel;
+	}
+	lept_stringify_value(&c, v);
+	if (length) {
+		*length = c.top;
+	}
+	PUTC(&c, '\0');
+	return c.stack;
+}
+
+static void lept_stringify_sink(lept_context* c, lept_write_fn write, void* ud, size_t buf_size) {
+	if (buf_size == 0) {
+		buf_size = LEPT_STRINGIFY_BUFFER_SIZE;
+	}
+	if (buf_size < 64) {
+		buf_size = 64;  /* 至少放得下一个数字，缓冲区不会扩容 */
+	}
+	lept_stringify_init(c, (char*)malloc(buf_size), buf_size);
+	c->write = write;
+	c->ud = ud;
+}
+
+int lept_stringify_to(const lept_value* v, lept_write_fn write, void* ud, size_t buf_size) {
+	lept_context c;
+	assert(v != NULL && write != NULL);
+	lept_stringify_sink(&c, write, ud, buf_size);
+	lept_stringify_value(&c, v);
+	lept_context_flush(&c);
+	free(c.stack);
+	return c.error;
+}
+
+/*
+	流式写入：不建立 lept_value 树，直接按调用顺序生成 JSON，复用 lept_stringify_value() 的转义和数字格式化。
+	逗号由 need_comma 决定，不检查调用顺序是否合法；调试版本另用一个栈记录每层是数组还是对象，用 assert() 检查。
+*/
+
+struct lept_writer {
+	lept_context c;
+	int need_comma;		/* 下一个值或键前面要加逗号 */
+#ifndef NDEBUG
+	char* nest;			/* 每层是 '[' 或 '{' */
+	size_t depth, capacity;
+	int has_key;		/* 对象中已写入键，等待值 */
+	int done;			/* 根值已经写完 */
+#endif
+};
+
+lept_writer* lept_writer_create(lept_write_fn write, void* ud, size_t buf_size) {
+	lept_writer* w = (lept_writer*)malloc(sizeof(lept_writer));
+	if (write != NULL) {
+		lept_stringify_sink(&w->c, write, ud, buf_size);
+	} else {
+		lept_stringify_init(&w->c, (char*)malloc(LEPT_PARSE_STRINGIFY_INIT_SIZE), LEPT_PARSE_STRINGIFY_INIT_SIZE);
+	}
+	w->need_comma = 0;
+#ifndef NDEBUG
+	w->nest = NULL;
+	w->depth = w->capacity = 0;
+	w->has_key = 0;
+	w->done = 0;
+#endif
+	return w;
+}
+
+#ifndef NDEBUG
+static void lept_writer_check_value(lept_writer* w) {
+	/* 值只能出现在根、数组中或键之后 */
+	assert(!w->done);
+	assert(w->depth == 0 || w->nest[w->depth - 1] == '[' || w->has_key);
+	w->has_key = 0;
+	if (w->depth == 0) {
+		w->done = 1;
+	}
+}
+#define LEPT_WRITER_CHECK_VALUE(w)	lept_writer_check_value(w)
+#else
+#define LEPT_WRITER_CHECK_VALUE(w)	((void)0)
+#endif
+
+static void lept_writer_comma(lept_writer* w) {
+	if (w->need_comma) {
+		PUTC(&w->c, ',');
+	}
+	w->need_comma = 1;
+}
+
+static void lept_writer_begin(lept_writer* w, char ch) {
+	LEPT_WRITER_CHECK_VALUE(w);
+#ifndef NDEBUG
+	if (w->depth == w->capacity) {
+		w->capacity = w->capacity == 0 ? 16 : 2 * w->capacity;
+		w->nest = (char*)realloc(w->nest, w->capacity);
+	}
+	w->nest[w->depth++] = ch;
+	w->done = 0;  /* 根容器要到结束时才算写完 */
+#endif
+	lept_writer_comma(w);
+	PUTC(&w->c, ch);
+	w->need_comma = 0;
+}
+
+static void lept_writer_end(lept_writer* w, char ch) {
+#ifndef NDEBUG
+	assert(w->depth > 0 && w->nest[w->depth - 1] == (ch == ']' ? '[' : '{') && !w->has_key);
+	if (--w->depth == 0) {
+		w->done = 1;
+	}
+#endif
+	PUTC(&w->c, ch);
+	w->need_comma = 1;
+}
+
+void lept_writer_begin_array(lept_writer* w) {
+	assert(w != NULL);
+	lept_writer_begin(w, '[');
+}
+
+void lept_writer_end_array(lept_writer* w) {
+	assert(w != NULL);
+	lept_writer_end(w, ']');
+}
+
+void lept_writer_begin_object(lept_writer* w) {
+	assert(w != NULL);
+	lept_writer_begin(w, '{');
+}
+
+void lept_writer_end_object(lept_writer* w) {
+	assert(w != NULL);
+	lept_writer_end(w, '}');
+}
+
+void lept_writer_key(lept_writer* w, const char* key, size_t klen) {
+	assert(w != NULL && key != NULL);
+#ifndef NDEBUG
+	assert(w->depth > 0 && w->nest[w->depth - 1] == '{' && !w->has_key);
+	w->has_key = 1;
+#endif
+	lept_writer_comma(w);
+	lept_stringify_string(&w->c, key, klen);
+	PUTC(&w->c, ':');
+	w->need_comma = 0;
+}
+
+void lept_writer_string(lept_writer* w, const char* s, size_t len) {
+	assert(w != NULL && (s != NULL || len == 0));
+	LEPT_WRITER_CHECK_VALUE(w);
+	lept_writer_comma(w);
+	lept_stringify_string(&w->c, len > 0 ? s : "", len);
+}
+
+void lept_writer_number(lept_writer* w, double n) {
+	assert(w != NULL);
+	LEPT_WRITER_CHECK_VALUE(w);
+	lept_writer_comma(w);
+	lept_stringify_number(&w->c, n);
+}
+
+void lept_writer_boolean(lept_writer* w, int b) {
+	assert(w != NULL);
+	LEPT_WRITER_CHECK_VALUE(w);
+	lept_writer_comma(w);
+	if (b) {
+		PUTS(&w->c, "true", 4);
+	} else {
+		PUTS(&w->c, "false", 5);
+	}
+}
+
+void lept_writer_null(lept_writer* w) {
+	assert(w != NULL);
+	LEPT_WRITER_CHECK_VALUE(w);
+	lept_writer_comma(w);
+	PUTS(&w->c, "null", 4);
+}
+
+void lept_writer_value(lept_writer* w, const lept_value* v) {
+	assert(w != NULL && v != NULL);
+	LEPT_WRITER_CHECK_VALUE(w);
+	lept_writer_comma(w);
+	lept_stringify_value(&w->c, v);
+}
+
+int lept_writer_finish(lept_writer* w, char** json, size_t* length) {
+	int error;
+	assert(w != NULL);
+#ifndef NDEBUG
+	assert(w->done);
+	free(w->nest);
+#endif
+	if (w->c.write != NULL) {
+		lept_context_flush(&w->c);
+		free(w->c.stack);
+		if (json) {
+			*json = NULL;
 		}
-		memcpy(m.k = (char*)malloc(m.klen + 1), str, m.klen);
-		m.k[m.klen] = '\0';
-		/* 解析空白和冒号 */
-		lept_parse_whitespace(c);
-		if (*c->json != ':') {
-			ret = LEPT_PARSE_MISS_COLON;
-			break;
+		if (length) {
+			*length = 0;  /* 数据已全部交给 write */
 		}
-		++c->json;
-		lept_parse_whitespace(c);
-		/* 解析值 value */
-		if ((ret = lept_parse_value(c, &m.v)) != LEPT_PARSE_OK) {
-			break;
+	} else {
+		if (length) {
+			*length = w->c.top;
 		}
-		memcpy(lept_context_push(c, sizeof(lept_member)), &m, sizeof(lept_member));
-		++size;
-		m.k = NULL;
-		/*
-			如果之前缺乏冒号，或是这里解析值失败，在函数返回前我们要释放 m.k。
-			如果我们成功地解析整个成员，那么就要把 m.k 设为空指针，
-			其意义是说明该键的字符串的拥有权已转移至栈，之后如遇到错误，
-			我们不会重覆释放栈里成员的键和这个临时成员的键。
-		*/
-		/* 解析逗号或者右花括号 */
-		lept_parse_whitespace(c);
-		if (*c->json == ',') {
-			++c->json;
-			lept_parse_whitespace(c);
-		} else if (*c->json == '}') {
-			++c->json;
-			lept_set_object(v, size);
-			memcpy(v->u.o.m, lept_context_pop(c, sizeof(lept_member) * size), sizeof(lept_member) * size);
-			v->u.o.size = size;
-			return LEPT_PARSE_OK;
+		PUTC(&w->c, '\0');
+		if (json) {
+			*json = w->c.stack;
 		} else {
-			ret = LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
-			break;
+			free(w->c.stack);
 		}
 	}
-	/*
-		最后，当 for (;;) 中遇到任何错误便会到达这步，
-		要释放临时的 key 字符串及栈上的成员。
-	*/
-	free(m.k);
-	for (i = 0; i < size; ++i) {
-		lept_member* m = (lept_member*)lept_context_pop(c, sizeof(lept_member));
-		free(m->k);
-		lept_free(&m->v);
+	error = w->c.error;
+	free(w);
+	return error;
+}
+
+/*
+	写入调用者提供的缓冲区：buf 就是 stack，写满时 lept_count_write() 把 stack 换成 scratch，
+	此后只计数不保存，最后返回所需的长度。
+*/
+#define LEPT_COUNTER_SCRATCH_SIZE 64	/* 大于单次压入的最大长度（数字、转义） */
+
+typedef struct {
+	lept_context* c;
+	size_t length;		/* 已经 flush 的字节数 */
+	char scratch[LEPT_COUNTER_SCRATCH_SIZE];
+}lept_counter;
+
+static int lept_count_write(void* ud, const char* data, size_t len) {
+	lept_counter* n = (lept_counter*)ud;
+	(void)data;
+	n->length += len;
+	n->c->stack = n->scratch;
+	n->c->size = sizeof(n->scratch);
+	return 0;
+}
+
+static size_t lept_stringify_count(const lept_value* v, char* buf, size_t cap) {
+	/* buf 为 NULL 时只计算长度 */
+	lept_context c;
+	lept_counter n;
+	n.c = &c;
+	n.length = 0;
+	if (buf != NULL) {
+		lept_stringify_init(&c, buf, cap);
+	} else {
+		lept_stringify_init(&c, n.scratch, sizeof(n.scratch));
 	}
-	v->type = LEPT_NULL;
-	return ret;
+	c.write = lept_count_write;
+	c.ud = &n;
+	lept_stringify_value(&c, v);
+	if (buf != NULL && c.stack == buf) {
+		buf[c.top] = '\0';  /* 没有写满过，c.top < cap */
+	}
+	return n.length + c.top;
 }
 
-static int lept_parse_value(lept_context* c, lept_value* v) {
-	switch (*c->json) {
-		case 'n':  return lept_parse_literal(c, v, "null", LEPT_NULL);
-		case 't':  return lept_parse_literal(c, v, "true", LEPT_TRUE);
-		case 'f':  return lept_parse_literal(c, v, "false", LEPT_FALSE);
-		default:   return lept_parse_number(c, v);
-		case '"':  return lept_parse_string(c, v);
-		case '[':  return lept_parse_array(c, v);
-		case '{':  return lept_parse_object(c, v);
-		case '\0': return LEPT_PARSE_EXPECT_VALUE;
+size_t lept_stringify_size(const lept_value* v) {
+	assert(v != NULL);
+	return lept_stringify_count(v, NULL, 0);
+}
+
+size_t lept_stringify_into(const lept_value* v, char* buf, size_t cap) {
+	size_t length;
+	assert(v != NULL && (buf != NULL || cap == 0));
+	if (cap >= LEPT_COUNTER_SCRATCH_SIZE) {
+		return lept_stringify_count(v, buf, cap);
+	}
+	/* 缓冲区太小时先计算长度，放得下再写，避免切换到 scratch 之前就要扩容 */
+	length = lept_stringify_count(v, NULL, 0);
+	if (length < cap) {
+		lept_stringify_count(v, buf, cap);
 	}
+	return length;
 }
 
-int lept_parse(lept_value* v, const char* json) {
+/*
+	iovec 列表：结构性的片段仍写入 stack，较长的不需转义的片段直接引用字符串本身。
+	stack 会 realloc，所以写入 stack 的片段先只记长度（base 为 NULL），
+	最后按顺序换算成指针——这些片段在 stack 中正好首尾相接。
+*/
+struct lept_iov_list {
+	lept_iovec* v;
+	size_t size, capacity;
+	size_t mark;	/* stack 中尚未加入列表的部分从这里开始 */
+};
+
+static void lept_iov_push(lept_iov_list* list, const char* base, size_t len) {
+	if (list->size == list->capacity) {
+		list->capacity = list->capacity == 0 ? 16 : list->capacity + (list->capacity >> 1);
+		list->v = (lept_iovec*)realloc(list->v, list->capacity * sizeof(lept_iovec));
+	}
+	list->v[list->size].base = base;
+	list->v[list->size].len = len;
+	++list->size;
+}
+
+static void lept_iov_close(lept_context* c) {
+	if (c->top > c->iov->mark) {
+		lept_iov_push(c->iov, NULL, c->top - c->iov->mark);
+		c->iov->mark = c->top;
+	}
+}
+
+static void lept_iov_ref(lept_context* c, const char* s, size_t len) {
+	lept_iov_close(c);
+	lept_iov_push(c->iov, s, len);
+}
+
+lept_iovec* lept_stringify_iovec(const lept_value* v, size_t* count, char** scratch) {
 	lept_context c;
-	int ret;
-	assert(v != NULL);
-	c.json = json;
-	c.stack = NULL;
-	c.size = c.top = 0;
-	lept_init(v);
-	lept_parse_whitespace(&c);
-	ret = lept_parse_value(&c, v);
-	if (ret == LEPT_PARSE_OK) {
-		lept_parse_whitespace(&c);
-		if (*c.json != '\0') {
-			v->type = LEPT_NULL;  /* 如果不置空，那么 c->json = "0123" 就会将 type 改成 LEPT_NUMBER */
-			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+	lept_iov_list list;
+	size_t i, offset = 0;
+	assert(v != NULL && count != NULL && scratch != NULL);
+	list.v = NULL;
+	list.size = list.capacity = list.mark = 0;
+	lept_stringify_init(&c, (char*)malloc(LEPT_PARSE_STRINGIFY_INIT_SIZE), LEPT_PARSE_STRINGIFY_INIT_SIZE);
+	c.iov = &list;
+	lept_stringify_value(&c, v);
+	lept_iov_close(&c);
+	for (i = 0; i < list.size; ++i) {
+		if (list.v[i].base == NULL) {
+			list.v[i].base = c.stack + offset;
+			offset += list.v[i].len;
 		}
 	}
-	assert(c.top == 0);
-	free(c.stack);  /* 解析完毕后，要将堆区申请的空间释放 */
-	return ret;
+	*count = list.size;
+	*scratch = c.stack;
+	return list.v;
 }
 
-#if 0
-/* 未优化 */
-static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
+int lept_writev_fd(int fd, const lept_iovec* iov, size_t count) {
+#ifdef _WIN32
 	size_t i;
-	assert(s != NULL);
-	PUTC(c, '"');
-	for (i = 0; i < len; ++i) {
-		unsigned char ch = (unsigned char)s[i];
-		switch (ch) {
-			case '\"':	PUTS(c, "\\\"", 2); break;
-			case '\\':	PUTS(c, "\\\\", 2); break;
-			case '\b':	PUTS(c, "\\b", 2); break;
-			case '\f':	PUTS(c, "\\f", 2); break;
-			case '\n':	PUTS(c, "\\n", 2); break;
-			case '\r':	PUTS(c, "\\r", 2); break;
-			case '\t':	PUTS(c, "\\t", 2); break;
-			default:
-				if (ch < 0x20) {
-					char buffer[7];
-					sprintf(buffer, "\\u%04X", ch);
-					PUTS(c, buffer, 6);
-				} else {
-					PUTC(c, s[i]);
-				}
+	for (i = 0; i < count; ++i) {
+		if (lept_write_fd(&fd, iov[i].base, iov[i].len) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+#else
+	struct iovec vec[LEPT_WRITEV_BATCH];
+	size_t i = 0, skip = 0;  /* iov[i] 的前 skip 字节已写出 */
+	while (i < count) {
+		size_t j;
+		int n = 0;
+		long w;
+		for (j = i; j < count && n < LEPT_WRITEV_BATCH; ++j, ++n) {
+			vec[n].iov_base = (void*)(iov[j].base + (j == i ? skip : 0));
+			vec[n].iov_len = iov[j].len - (j == i ? skip : 0);
+		}
+		w = (long)writev(fd, vec, n);
+		if (w < 0 && errno == EINTR) {
+			continue;
+		}
+		if (w <= 0) {
+			return -1;
 		}
+		while (i < count && (size_t)w >= iov[i].len - skip) {
+			w -= (long)(iov[i].len - skip);
+			skip = 0;
+			++i;
+		}
+		skip += (size_t)w;
 	}
-	PUTC(c, '"');
+	return 0;
+#endif
 }
+
+int lept_write_fd(void* ud, const char* data, size_t len) {
+	int fd = *(const int*)ud;
+	while (len > 0) {
+#ifdef _WIN32
+		int n = _write(fd, data, len > 0x40000000u ? 0x40000000u : (unsigned)len);
 #else
-/* 优化后 */
-static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
-	static const char hex_digits[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
-	size_t i, size;
-	char* p, * head;
-	assert(s != NULL);
-	p = head = lept_context_push(c, size = 6 * len + 2);
-	*p++ = '"';
-	for (i = 0; i < len; ++i) {
-		unsigned char ch = (unsigned char)s[i];
-		switch (ch) {
-			case '\"': *p++ = '\\'; *p++ = '\"'; break;
-			case '\\': *p++ = '\\'; *p++ = '\\'; break;
-			case '\b': *p++ = '\\'; *p++ = 'b';  break;
-			case '\f': *p++ = '\\'; *p++ = 'f';  break;
-			case '\n': *p++ = '\\'; *p++ = 'n';  break;
-			case '\r': *p++ = '\\'; *p++ = 'r';  break;
-			case '\t': *p++ = '\\'; *p++ = 't';  break;
-			default:
-				if (ch < 0x20) {
-					*p++ = '\\'; *p++ = 'u'; *p++ = '0'; *p++ = '0';
-					*p++ = hex_digits[ch >> 4];
-					*p++ = hex_digits[ch & 15];
-				} else {
-					*p++ = s[i];
-				}
+		long n = (long)write(fd, data, len > 0x40000000u ? 0x40000000u : len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+#endif
+		if (n <= 0) {
+			return -1;
 		}
+		data += n;
+		len -= (size_t)n;
 	}
-	*p++ = '"';
-	c->top -= size - (p - head);
+	return 0;
 }
-#endif
 
-static void lept_stringify_value(lept_context* c, const lept_value* v) {
-	size_t i;
-	switch (v->type) {
-		case LEPT_NULL:		PUTS(c, "null", 4); break;
-		case LEPT_FALSE:	PUTS(c, "false", 5); break;
-		case LEPT_TRUE:		PUTS(c, "true", 4); break;
-		case LEPT_NUMBER:	c->top -= 32 - sprintf(lept_context_push(c, 32), "%.17g", v->u.n); break;
-		case LEPT_STRING:	lept_stringify_string(c, v->u.s.s, v->u.s.len); break;
-		case LEPT_ARRAY:
-			PUTC(c, '[');
-			for (i = 0; i < v->u.a.size; ++i) {
-				if (i > 0) {
-					PUTC(c, ',');
-				}
-				lept_stringify_value(c, &v->u.a.e[i]);
-			}
-			PUTC(c, ']');
-			break;
-		case LEPT_OBJECT:
-			PUTC(c, '{');
-			for (i = 0; i < v->u.o.size; ++i) {
-				if (i > 0) {
-					PUTC(c, ',');
-				}
-				lept_stringify_string(c, v->u.o.m[i].k, v->u.o.m[i].klen);
-				PUTC(c, ':');
-				lept_stringify_value(c, &v->u.o.m[i].v);
-			}
-			PUTC(c, '}');
-			break;
-		default:			assert(0 && "invalid type");
-	}
+int lept_write_file(void* ud, const char* data, size_t len) {
+	return fwrite(data, 1, len, (FILE*)ud) == len ? 0 : -1;
 }
 
-char* lept_stringify(const lept_value* v, size_t* length) {
+char* lept_stringify_canonical(const lept_value* v, size_t* length) {
 	lept_context c;
+	lept_canon canon;
 	assert(v != NULL);
-	c.stack = (char*)malloc(c.size = LEPT_PARSE_STRINGIFY_INIT_SIZE);
-	c.top = 0;
+	canon.m = NULL;
+	canon.top = canon.capacity = 0;
+	lept_stringify_init(&c, (char*)malloc(LEPT_PARSE_STRINGIFY_INIT_SIZE), LEPT_PARSE_STRINGIFY_INIT_SIZE);
+	c.canon = &canon;
 	lept_stringify_value(&c, v);
+	free(canon.m);
 	if (length) {
 		*length = c.top;
 	}
@@ -536,21 +3941,84 @@ char* lept_stringify(const lept_value* v, size_t* length) {
 	return c.stack;
 }
 
+lept_stringify_cache* lept_stringify_cache_create(void) {
+	lept_stringify_cache* cache = (lept_stringify_cache*)malloc(sizeof(lept_stringify_cache));
+	cache->prev = NULL;
+	cache->length = 0;
+	cache->old.e = cache->cur.e = cache->hit.e = NULL;
+	cache->old.size = cache->old.capacity = cache->cur.size = cache->cur.capacity = 0;
+	cache->hit.size = cache->hit.capacity = 0;
+	return cache;
+}
+
+void lept_stringify_cache_free(lept_stringify_cache* cache) {
+	if (cache != NULL) {
+		free(cache->prev);
+		free(cache->old.e);
+		free(cache->cur.e);
+		free(cache->hit.e);
+		free(cache);
+	}
+}
+
+const char* lept_stringify_cached(lept_value* v, lept_stringify_cache* cache, size_t* length) {
+	lept_context c;
+	lept_cache_table t;
+	size_t size;
+	assert(v != NULL && cache != NULL);
+	size = cache->length + LEPT_PARSE_STRINGIFY_INIT_SIZE;  /* 通常与上一次差不多长 */
+	lept_cache_clear(&cache->hit);
+	lept_cache_check(cache, v);
+	lept_stringify_init(&c, (char*)malloc(size), size);
+	c.cache = cache;
+	lept_stringify_value(&c, v);
+	cache->length = c.top;
+	if (length) {
+		*length = c.top;
+	}
+	PUTC(&c, '\0');
+	free(cache->prev);
+	cache->prev = c.stack;
+	/* 本次的位置表成为下一次的旧表 */
+	t = cache->old;
+	cache->old = cache->cur;
+	cache->cur = t;
+	lept_cache_clear(&cache->cur);
+	return cache->prev;
+}
+
 void lept_copy(lept_value* dst, const lept_value* src) {
 	size_t i;
 	assert(dst != NULL && src != NULL && dst != src);
 	switch (src->type) {
 		case LEPT_STRING:
-			lept_set_string(dst, src->u.s.s, src->u.s.len);
+			lept_set_string_flags(dst, src->u.s.s, src->u.s.len, src->flags & LEPT_FLAG_CLEAN);
 			break;
 		case LEPT_ARRAY:
-			lept_set_array(dst, src->u.a.size);
-			for (i = 0; i < src->u.a.size; ++i) {
-				lept_copy(&dst->u.a.e[i], &src->u.a.e[i]);
+			if (IS_PACKED(src)) {
+				lept_set_array_doubles(dst, src->u.pa.d, src->u.pa.size);
+				break;
+			}
+			if (IS_SEGMENTED(src)) {
+				lept_set_segmented_array(dst, src->u.sa.size);
+			} else {
+				lept_set_array(dst, src->u.a.size);
+			}
+			for (i = 0; i < lept_get_array_size(src); ++i) {
+				lept_copy(lept_pushback_array_element(dst), lept_array_at(src, i));
 			}
-			dst->u.a.size = src->u.a.size;
 			break;
 		case LEPT_OBJECT:
+			if (IS_SHAPED(src)) {
+				/* 形状不可变，直接共用，只复制值 */
+				size_t size = src->u.so.shape->size;
+				lept_set_shaped_object(dst, lept_shape_retain(src->u.so.shape), size);
+				for (i = 0; i < size; ++i) {
+					lept_init(&dst->u.so.v[i]);
+					lept_copy(&dst->u.so.v[i], &src->u.so.v[i]);
+				}
+				break;
+			}
 			lept_set_object(dst, src->u.o.size);
 			for (i = 0; i < src->u.o.size; ++i) {
 				/*
@@ -564,11 +4032,11 @@ void lept_copy(lept_value* dst, const lept_value* src) {
 				lept_value* val = lept_set_object_value(dst, src->u.o.m[i].k, src->u.o.m[i].klen);
 				lept_copy(val, &src->u.o.m[i].v);
 			}
-			dst->u.o.size = src->u.o.size;
 			break;
 		default:
 			lept_free(dst);
 			memcpy(dst, src, sizeof(lept_value));
+			LEPT_TOUCH(dst);  /* 不要把 src 的缓存标记也复制过来 */
 			break;
 	}
 }
@@ -577,6 +4045,7 @@ void lept_move(lept_value* dst, lept_value* src) {
 	assert(dst != NULL && src != NULL && dst != src);
 	lept_free(dst);
 	memcpy(dst, src, sizeof(lept_value));
+	LEPT_TOUCH(dst);  /* 父容器的内容变了 */
 	lept_init(src);  /* 释放 src 对原来内存空间的所有权 */
 	/* 此处不能用 lept_free(src)，比如转移的是字符串类型的，如果 lept_free 就会把堆区的空间释放 */
 }
@@ -588,6 +4057,8 @@ void lept_swap(lept_value* lhs, lept_value* rhs) {
 		memcpy(&temp, lhs, sizeof(lept_value));
 		memcpy(lhs, rhs, sizeof(lept_value));
 		memcpy(rhs, &temp, sizeof(lept_value));
+		LEPT_TOUCH(lhs);
+		LEPT_TOUCH(rhs);
 	}
 }
 
@@ -599,12 +4070,31 @@ void lept_free(lept_value* v) {
 			free(v->u.s.s);
 			break;
 		case LEPT_ARRAY:
-			for (i = 0; i < v->u.a.size; ++i) {
-				lept_free(&v->u.a.e[i]);
+			if (IS_PACKED(v)) {
+				free(v->u.pa.d);
+				break;
+			}
+			for (i = 0; i < lept_get_array_size(v); ++i) {
+				lept_free(lept_array_at(v, i));
+			}
+			if (IS_SEGMENTED(v)) {
+				for (i = 0; i < v->u.sa.capacity >> LEPT_ARRAY_BLOCK_SHIFT; ++i) {
+					free(v->u.sa.b[i]);
+				}
+				free(v->u.sa.b);
+				break;
 			}
 			free(v->u.a.e);
 			break;
 		case LEPT_OBJECT:
+			if (IS_SHAPED(v)) {
+				for (i = 0; i < v->u.so.shape->size; ++i) {
+					lept_free(&v->u.so.v[i]);
+				}
+				free(v->u.so.v);
+				lept_shape_release(v->u.so.shape);
+				break;
+			}
 			for (i = 0; i < v->u.o.size; ++i) {
 				free(v->u.o.m[i].k);
 				lept_free(&v->u.o.m[i].v);
@@ -615,6 +4105,7 @@ void lept_free(lept_value* v) {
 			break;
 	}
 	v->type = LEPT_NULL;  /* 把类型变为 LEPT_NULL 可以避免重复释放 */
+	v->flags = 0;
 }
 
 lept_type lept_get_type(const lept_value* v) {
@@ -623,6 +4114,7 @@ lept_type lept_get_type(const lept_value* v) {
 
 int lept_is_equal(const lept_value* lhs, const lept_value* rhs) {
 	size_t i;
+	double n1, n2;
 	assert(lhs != NULL && rhs != NULL);
 	if (lhs->type != rhs->type) return 0;
 	switch (lhs->type) {
@@ -632,17 +4124,31 @@ int lept_is_equal(const lept_value* lhs, const lept_value* rhs) {
 		case LEPT_NUMBER:
 			return lhs->u.n == rhs->u.n;
 		case LEPT_ARRAY:
-			if (lhs->u.a.size != rhs->u.a.size) return 0;
-			for (i = 0; i < lhs->u.a.size; ++i) {
-				if (lept_is_equal(&lhs->u.a.e[i], &rhs->u.a.e[i]) == 0) return 0;
+			if (lept_get_array_size(lhs) != lept_get_array_size(rhs)) return 0;
+			if (IS_PACKED(lhs) || IS_PACKED(rhs)) {
+				/* 至少一边是紧凑存储，另一边的元素也必须全是数字 */
+				for (i = 0; i < lept_get_array_size(lhs); ++i) {
+					if (lept_array_number(lhs, i, &n1) == 0 || lept_array_number(rhs, i, &n2) == 0 || n1 != n2) return 0;
+				}
+				return 1;
+			}
+			for (i = 0; i < lept_get_array_size(lhs); ++i) {
+				if (lept_is_equal(lept_array_at(lhs, i), lept_array_at(rhs, i)) == 0) return 0;
 			}
 			return 1;
 		case LEPT_OBJECT:
-			if (lhs->u.o.size != rhs->u.o.size) return 0;
-			for (i = 0; i < lhs->u.o.size; ++i) {
-				size_t rhs_idx = lept_find_object_index(rhs, lhs->u.o.m[i].k, lhs->u.o.m[i].klen);
+			if (lept_get_object_size(lhs) != lept_get_object_size(rhs)) return 0;
+			if (IS_SHAPED(lhs) && IS_SHAPED(rhs) && lhs->u.so.shape == rhs->u.so.shape) {
+				/* 形状相同，键的顺序也相同，逐个比较值即可 */
+				for (i = 0; i < lhs->u.so.shape->size; ++i) {
+					if (lept_is_equal(&lhs->u.so.v[i], &rhs->u.so.v[i]) == 0) return 0;
+				}
+				return 1;
+			}
+			for (i = 0; i < lept_get_object_size(lhs); ++i) {
+				size_t rhs_idx = lept_find_object_index(rhs, lept_get_object_key(lhs, i), lept_get_object_key_length(lhs, i));
 				if (rhs_idx == LEPT_KEY_NOT_EXIST) return 0;
-				if (lept_is_equal(&lhs->u.o.m[i].v, &rhs->u.o.m[rhs_idx].v) == 0) return 0;
+				if (lept_is_equal(lept_get_object_value(lhs, i), lept_get_object_value(rhs, rhs_idx)) == 0) return 0;
 			}
 			return 1;
 		default:
@@ -681,7 +4187,8 @@ size_t lept_get_string_length(const lept_value* v) {
 	return v->u.s.len;
 }
 
-void lept_set_string(lept_value* v, const char* s, size_t len) {
+static void lept_set_string_flags(lept_value* v, const char* s, size_t len, unsigned flags) {
+	/* lept_set_string() 的实现，flags 是调用者已经知道的 LEPT_FLAG_CLEAN */
 	assert(v != NULL && (s != NULL || len == 0));
 	lept_free(v);
 	v->u.s.s = (char*)malloc(len + 1);
@@ -689,6 +4196,7 @@ void lept_set_string(lept_value* v, const char* s, size_t len) {
 	v->u.s.s[len] = '\0';
 	v->u.s.len = len;
 	v->type = LEPT_STRING;
+	v->flags = flags;
 	/*
 		为什么要加 lept_free() 函数 ？ 之我的理解：
 		首先，在解析 json 时会申请一个 lept_value 的变量 v，然后将 &v 传入
@@ -699,6 +4207,12 @@ void lept_set_string(lept_value* v, const char* s, size_t len) {
 	*/
 }
 
+void lept_set_string(lept_value* v, const char* s, size_t len) {
+	/* 设置时就检查是否需要转义，生成 JSON 时不必再修改值 */
+	assert(v != NULL && (s != NULL || len == 0));
+	lept_set_string_flags(v, s, len, len == 0 || lept_scan_clean(s, len) == len ? LEPT_FLAG_CLEAN : 0);
+}
+
 void lept_set_array(lept_value* v, size_t capacity) {
 	assert(v != NULL);
 	lept_free(v);
@@ -708,20 +4222,43 @@ void lept_set_array(lept_value* v, size_t capacity) {
 	v->u.a.e = capacity > 0 ? (lept_value*)malloc(capacity * sizeof(lept_value)) : NULL;
 }
 
+void lept_set_segmented_array(lept_value* v, size_t capacity) {
+	assert(v != NULL);
+	lept_free(v);
+	v->type = LEPT_ARRAY;
+	v->flags = LEPT_FLAG_SEGMENTED;
+	v->u.sa.b = NULL;
+	v->u.sa.size = 0;
+	v->u.sa.capacity = 0;
+	lept_reserve_segments(v, capacity);
+}
+
 size_t lept_get_array_size(const lept_value* v) {
 	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (IS_PACKED(v)) return v->u.pa.size;
+	if (IS_SEGMENTED(v)) return v->u.sa.size;
 	return v->u.a.size;
 }
 
 size_t lept_get_array_capacity(const lept_value* v) {
 	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (IS_PACKED(v)) return v->u.pa.capacity;
+	if (IS_SEGMENTED(v)) return v->u.sa.capacity;
 	return v->u.a.capacity;
 }
 
 void lept_reserve_array(lept_value* v, size_t capacity) {
 	/* 扩容 */
 	assert(v != NULL && v->type == LEPT_ARRAY);
-	if (v->u.a.capacity < capacity) {
+	LEPT_TOUCH(v);
+	if (IS_PACKED(v)) {
+		if (v->u.pa.capacity < capacity) {
+			v->u.pa.capacity = capacity;
+			v->u.pa.d = (double*)realloc(v->u.pa.d, capacity * sizeof(double));
+		}
+	} else if (IS_SEGMENTED(v)) {
+		lept_reserve_segments(v, capacity);  /* 分块存储的容量总是块大小的整数倍 */
+	} else if (v->u.a.capacity < capacity) {
 		v->u.a.capacity = capacity;
 		v->u.a.e = (lept_value*)realloc(v->u.a.e, capacity * sizeof(lept_value));
 	}
@@ -730,7 +4267,15 @@ void lept_reserve_array(lept_value* v, size_t capacity) {
 void lept_shrink_array(lept_value* v) {
 	/* 当数组不需要再修改，可以使用以下的函数，把容量缩小至刚好能放置现有元素 */
 	assert(v != NULL && v->type == LEPT_ARRAY);
-	if (v->u.a.capacity > v->u.a.size) {
+	LEPT_TOUCH(v);
+	if (IS_PACKED(v)) {
+		if (v->u.pa.capacity > v->u.pa.size) {
+			v->u.pa.capacity = v->u.pa.size;
+			v->u.pa.d = (double*)realloc(v->u.pa.d, v->u.pa.capacity * sizeof(double));
+		}
+	} else if (IS_SEGMENTED(v)) {
+		lept_shrink_segments(v);  /* 只释放多余的整块 */
+	} else if (v->u.a.capacity > v->u.a.size) {
 		v->u.a.capacity = v->u.a.size;
 		v->u.a.e = (lept_value*)realloc(v->u.a.e, v->u.a.capacity * sizeof(lept_value));
 	}
@@ -739,22 +4284,43 @@ void lept_shrink_array(lept_value* v) {
 void lept_clear_array(lept_value* v) {
 	/* 清除所有元素（不改容量） */
 	assert(v != NULL && v->type == LEPT_ARRAY);
-	lept_erase_array_element(v, 0, v->u.a.size);
+	lept_erase_array_element(v, 0, lept_get_array_size(v));
 }
 
 lept_value* lept_get_array_element(const lept_value* v, size_t index) {
+	/* 紧凑存储没有 lept_value 可以返回，调用者要先 lept_unpack_array()，这里不修改 v */
 	assert(v != NULL && v->type == LEPT_ARRAY);
-	assert(index < v->u.a.size);
-	return &v->u.a.e[index];
+	assert(index < lept_get_array_size(v));
+	return lept_array_at(v, index);
+}
+
+double lept_get_array_number(const lept_value* v, size_t index) {
+	double n = 0.0;
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	assert(index < lept_get_array_size(v));
+	if (lept_array_number(v, index, &n) == 0) {
+		assert(!"array element is not a number");
+	}
+	return n;
 }
 
 lept_value* lept_pushback_array_element(lept_value* v) {
 	/*
 		lept_pushback_array_element() 在数组末端压入一个元素，返回新的元素指针。
 		如果现有的容量不足，就需要调用 lept_reserve_array() 扩容。
-		我们现在用了一个最简单的扩容公式：若容量为 0，则分配 1 个元素；其他情况倍增容量
+		我们现在用了一个最简单的扩容公式：若容量为 0，则分配 1 个元素；其他情况倍增容量。
+		分块存储每次只需多分配一块，不必倍增
 	*/
+	lept_value* e;
 	assert(v != NULL && v->type == LEPT_ARRAY);
+	LEPT_TOUCH(v);
+	lept_unpack_array(v);  /* 新元素可能不是数字 */
+	if (IS_SEGMENTED(v)) {
+		lept_reserve_segments(v, v->u.sa.size + 1);
+		e = lept_array_at(v, v->u.sa.size++);
+		lept_init(e);
+		return e;
+	}
 	if (v->u.a.size == v->u.a.capacity) {
 		lept_reserve_array(v, v->u.a.capacity == 0 ? 1 : 2 * v->u.a.capacity);
 	}
@@ -763,38 +4329,247 @@ lept_value* lept_pushback_array_element(lept_value* v) {
 }
 
 void lept_popback_array_element(lept_value* v) {
-	assert(v != NULL && v->type == LEPT_ARRAY && v->u.a.size > 0);
+	assert(v != NULL && v->type == LEPT_ARRAY && lept_get_array_size(v) > 0);
+	LEPT_TOUCH(v);
+	if (IS_PACKED(v)) {
+		--v->u.pa.size;
+		return;
+	}
+	if (IS_SEGMENTED(v)) {
+		lept_free(lept_array_at(v, --v->u.sa.size));
+		return;
+	}
 	lept_free(&v->u.a.e[--v->u.a.size]);
 }
 
+static void lept_array_set_size(lept_value* v, size_t size) {
+	if (IS_PACKED(v)) {
+		v->u.pa.size = size;
+	} else if (IS_SEGMENTED(v)) {
+		v->u.sa.size = size;
+	} else {
+		v->u.a.size = size;
+	}
+}
+
+static void lept_array_move(lept_value* v, size_t dst, size_t src, size_t count) {
+	/* 区间可以重叠 */
+	if (count == 0) {
+		return;
+	}
+	if (IS_PACKED(v)) {
+		memmove(&v->u.pa.d[dst], &v->u.pa.d[src], count * sizeof(double));
+	} else if (IS_SEGMENTED(v)) {
+		lept_move_segments(v, dst, src, count);
+	} else {
+		memmove(&v->u.a.e[dst], &v->u.a.e[src], count * sizeof(lept_value));
+	}
+}
+
+static void lept_array_open(lept_value* v, size_t index, size_t delete_count, size_t count) {
+	/* 释放 [index, index + delete_count) 的元素，再在 index 处空出 count 个未初始化的位置，最多扩容一次 */
+	size_t i, size = lept_get_array_size(v), capacity = lept_get_array_capacity(v);
+	size_t new_size = size - delete_count + count;
+	assert(!IS_PACKED(v));
+	LEPT_TOUCH(v);
+	for (i = 0; i < delete_count; ++i) {
+		lept_free(lept_array_at(v, index + i));
+	}
+	if (new_size > capacity) {
+		lept_reserve_array(v, IS_SEGMENTED(v) || new_size > 2 * capacity ? new_size : 2 * capacity);
+	}
+	lept_array_move(v, index + count, index + delete_count, size - index - delete_count);
+	lept_array_set_size(v, new_size);
+}
+
+static void lept_array_close(lept_value* v, size_t index, size_t count) {
+	/* 把 [index, index + count) 之后的元素前移，这些元素已被释放或转移给别处 */
+	size_t size = lept_get_array_size(v);
+	LEPT_TOUCH(v);
+	lept_array_move(v, index, index + count, size - index - count);
+	lept_array_set_size(v, size - count);
+}
+
 lept_value* lept_insert_array_element(lept_value* v, size_t index) {
 	/*  在 index 位置插入一个元素 */
-	assert(v != NULL && v->type == LEPT_ARRAY && index <= v->u.a.size);
-	if (v->u.a.size == v->u.a.capacity) {
-		lept_reserve_array(v, v->u.a.capacity == 0 ? 1 : 2 * v->u.a.capacity);
-	}
-	memcpy(&v->u.a.e[index + 1], &v->u.a.e[index], (v->u.a.size - index) * sizeof(lept_value));
-	lept_init(&v->u.a.e[index]);
-	++v->u.a.size;
-	return &v->u.a.e[index];
+	lept_value* e;
+	assert(v != NULL && v->type == LEPT_ARRAY && index <= lept_get_array_size(v));
+	lept_unpack_array(v);
+	lept_array_open(v, index, 0, 1);  /* 分块存储只在各块内 memmove，不需要重新分配整个数组 */
+	e = lept_array_at(v, index);
+	lept_init(e);
+	return e;
 }
 
 void lept_erase_array_element(lept_value* v, size_t index, size_t count) {
 	/* 删去在 index 位置开始共 count 个元素（不改容量） */
+	assert(v != NULL && v->type == LEPT_ARRAY && index + count <= lept_get_array_size(v));
+	if (IS_PACKED(v)) {
+		lept_array_close(v, index, count);  /* 数字不需要释放 */
+		return;
+	}
+	lept_array_open(v, index, count, 0);
+}
+
+void lept_splice_array(lept_value* dst, size_t index, size_t delete_count, lept_value* src, size_t src_from, size_t count, int move) {
+	/*
+		把 dst 中 [index, index + delete_count) 的元素替换为 src 中 [src_from, src_from + count) 的元素。
+		move 非 0 时直接转移元素的所有权（不做深复制），并把这些元素从 src 中删去；否则逐个 lept_copy()。
+		dst 只扩容一次，后面的元素用一次 memmove 移到位。
+		src 与 dst 相同时，先把来源区间取出到临时缓冲区，再当作外部来源插入，
+		move 的来源区间不能与删除区间重叠。
+	*/
+	lept_value* tmp = NULL;
+	lept_value* e;
 	size_t i;
-	assert(v != NULL && v->type == LEPT_ARRAY && index + count - 1 < v->u.a.size);
+	assert(dst != NULL && dst->type == LEPT_ARRAY && index + delete_count <= lept_get_array_size(dst));
+	assert(count == 0 || (src != NULL && src->type == LEPT_ARRAY && src_from + count <= lept_get_array_size(src)));
+	lept_unpack_array(dst);
+	if (src == dst && count > 0) {
+		tmp = (lept_value*)malloc(count * sizeof(lept_value));
+		if (move) {
+			assert(src_from + count <= index || src_from >= index + delete_count);
+			for (i = 0; i < count; ++i) {
+				tmp[i] = *lept_array_at(dst, src_from + i);
+			}
+			lept_array_close(dst, src_from, count);
+			if (src_from < index) {
+				index -= count;
+			}
+		} else {
+			for (i = 0; i < count; ++i) {
+				lept_init(&tmp[i]);
+				lept_copy(&tmp[i], lept_array_at(dst, src_from + i));
+			}
+		}
+	}
+	lept_array_open(dst, index, delete_count, count);
 	for (i = 0; i < count; ++i) {
-		lept_free(&v->u.a.e[index + i]);
+		e = lept_array_at(dst, index + i);
+		if (tmp != NULL) {
+			*e = tmp[i];
+		} else if (IS_PACKED(src)) {
+			lept_init(e);
+			lept_set_number(e, src->u.pa.d[src_from + i]);  /* 紧凑来源不必先转回普通存储 */
+		} else if (move) {
+			*e = *lept_array_at(src, src_from + i);
+		} else {
+			lept_init(e);
+			lept_copy(e, lept_array_at(src, src_from + i));
+		}
+	}
+	if (tmp != NULL) {
+		free(tmp);
+	} else if (move && count > 0) {
+		lept_array_close(src, src_from, count);
+	}
+}
+
+void lept_set_array_doubles(lept_value* v, const double* d, size_t n) {
+	assert(v != NULL && (d != NULL || n == 0));
+	lept_set_packed_array(v, n);
+	if (n > 0) {
+		memcpy(v->u.pa.d, d, n * sizeof(double));
+	}
+	v->u.pa.size = n;
+}
+
+int lept_pack_array(lept_value* v) {
+	size_t i, size, capacity;
+	double* d;
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (IS_PACKED(v)) {
+		return 1;
+	}
+	size = lept_get_array_size(v);
+	capacity = lept_get_array_capacity(v);
+	for (i = 0; i < size; ++i) {
+		if (lept_array_at(v, i)->type != LEPT_NUMBER) {
+			return 0;
+		}
+	}
+	d = capacity > 0 ? (double*)malloc(capacity * sizeof(double)) : NULL;
+	for (i = 0; i < size; ++i) {
+		d[i] = lept_array_at(v, i)->u.n;
+	}
+	lept_set_packed_array(v, 0);  /* 元素都是数字，lept_free() 只释放存储 */
+	v->u.pa.d = d;
+	v->u.pa.size = size;
+	v->u.pa.capacity = capacity;
+	return 1;
+}
+
+void lept_unpack_array(lept_value* v) {
+	/* 转回普通存储，容量不变 */
+	size_t i, size, capacity;
+	double* d;
+	lept_value* e;
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (!IS_PACKED(v)) {
+		return;
+	}
+	LEPT_TOUCH(v);  /* 存储地址变了 */
+	size = v->u.pa.size;
+	capacity = v->u.pa.capacity;
+	d = v->u.pa.d;
+	e = capacity > 0 ? (lept_value*)malloc(capacity * sizeof(lept_value)) : NULL;
+	for (i = 0; i < size; ++i) {
+		lept_init(&e[i]);
+		e[i].type = LEPT_NUMBER;
+		e[i].u.n = d[i];
+	}
+	free(d);
+	v->flags &= ~LEPT_FLAG_PACKED;
+	v->u.a.e = e;
+	v->u.a.size = size;
+	v->u.a.capacity = capacity;
+}
+
+const double* lept_get_array_doubles(const lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	return IS_PACKED(v) ? v->u.pa.d : NULL;
+}
+
+double lept_get_array_sum(const lept_value* v) {
+	size_t i;
+	double s = 0.0;
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (IS_PACKED(v)) {
+		return lept_sum_doubles(v->u.pa.d, v->u.pa.size);
+	}
+	for (i = 0; i < lept_get_array_size(v); ++i) {
+		s += lept_get_number(lept_array_at(v, i));
+	}
+	return s;
+}
+
+static double lept_get_array_minmax(const lept_value* v, int max) {
+	size_t i;
+	double r;
+	assert(v != NULL && v->type == LEPT_ARRAY && lept_get_array_size(v) > 0);
+	if (IS_PACKED(v)) {
+		return lept_minmax_doubles(v->u.pa.d, v->u.pa.size, max);
 	}
-	memcpy(&v->u.a.e[index], &v->u.a.e[index + count], (v->u.a.size - index - count) * sizeof(lept_value));
-	/* 回收完空间，然后将 index 后面 count 个元素移到 index 处，最后将空闲的 count 个元素重新初始化 */
-	for (i = v->u.a.size - count; i < v->u.a.size; ++i) {
-		lept_init(&v->u.a.e[i]);
+	r = lept_get_number(lept_array_at(v, 0));
+	for (i = 1; i < lept_get_array_size(v); ++i) {
+		double n = lept_get_number(lept_array_at(v, i));
+		if (max ? n > r : n < r) {
+			r = n;
+		}
 	}
-	v->u.a.size -= count;
+	return r;
+}
+
+double lept_get_array_min(const lept_value* v) {
+	return lept_get_array_minmax(v, 0);
+}
+
+double lept_get_array_max(const lept_value* v) {
+	return lept_get_array_minmax(v, 1);
 }
 
 void lept_set_object(lept_value* v, size_t capacity) {
+	/* 新建的对象使用 lept_member 布局，形状只由解析建立 */
 	assert(v != NULL);
 	lept_free(v);
 	v->type = LEPT_OBJECT;
@@ -803,19 +4578,44 @@ void lept_set_object(lept_value* v, size_t capacity) {
 	v->u.o.m = capacity > 0 ? (lept_member*)malloc(capacity * sizeof(lept_member)) : NULL;
 }
 
+static void lept_unshape_object(lept_value* v) {
+	/* 形状布局退回 lept_member 布局，容量不变 */
+	size_t i, size = v->u.so.shape->size, capacity = v->u.so.capacity;
+	lept_shape* shape = v->u.so.shape;
+	lept_value* e = v->u.so.v;
+	lept_member* m = capacity > 0 ? (lept_member*)malloc(capacity * sizeof(lept_member)) : NULL;
+	for (i = 0; i < size; ++i) {
+		m[i].klen = shape->list->keys[i].klen;
+		memcpy(m[i].k = (char*)malloc(m[i].klen + 1), shape->list->keys[i].k, m[i].klen + 1);
+		memcpy(&m[i].v, &e[i], sizeof(lept_value));
+	}
+	free(e);
+	lept_shape_release(shape);
+	v->flags &= ~(LEPT_FLAG_SHAPED | LEPT_FLAG_CACHED);
+	v->u.o.m = m;
+	v->u.o.size = size;
+	v->u.o.capacity = capacity;
+}
+
 size_t lept_get_object_size(const lept_value* v) {
 	assert(v != NULL && v->type == LEPT_OBJECT);
-	return v->u.o.size;
+	return IS_SHAPED(v) ? v->u.so.shape->size : v->u.o.size;
 }
 
 size_t lept_get_object_capacity(const lept_value* v) {
 	assert(v != NULL && v->type == LEPT_OBJECT);
-	return v->u.o.capacity;
+	return IS_SHAPED(v) ? v->u.so.capacity : v->u.o.capacity;
 }
 
 void lept_reserve_object(lept_value* v, size_t capacity) {
 	assert(v != NULL && v->type == LEPT_OBJECT);
-	if (v->u.o.capacity < capacity) {
+	LEPT_TOUCH(v);
+	if (IS_SHAPED(v)) {
+		if (v->u.so.capacity < capacity) {
+			v->u.so.capacity = capacity;
+			v->u.so.v = (lept_value*)realloc(v->u.so.v, capacity * sizeof(lept_value));
+		}
+	} else if (v->u.o.capacity < capacity) {
 		v->u.o.capacity = capacity;
 		v->u.o.m = (lept_member*)realloc(v->u.o.m, capacity * sizeof(lept_member));
 	}
@@ -823,7 +4623,13 @@ void lept_reserve_object(lept_value* v, size_t capacity) {
 
 void lept_shrink_object(lept_value* v) {
 	assert(v != NULL && v->type == LEPT_OBJECT);
-	if (v->u.o.size < v->u.o.capacity) {
+	LEPT_TOUCH(v);
+	if (IS_SHAPED(v)) {
+		if (v->u.so.shape->size < v->u.so.capacity) {
+			v->u.so.capacity = v->u.so.shape->size;
+			v->u.so.v = (lept_value*)realloc(v->u.so.v, v->u.so.capacity * sizeof(lept_value));
+		}
+	} else if (v->u.o.size < v->u.o.capacity) {
 		v->u.o.capacity = v->u.o.size;
 		v->u.o.m = (lept_member*)realloc(v->u.o.m, v->u.o.capacity * sizeof(lept_member));
 	}
@@ -832,6 +4638,14 @@ void lept_shrink_object(lept_value* v) {
 void lept_clear_object(lept_value* v) {
 	size_t i;
 	assert(v != NULL && v->type == LEPT_OBJECT);
+	LEPT_TOUCH(v);
+	if (IS_SHAPED(v)) {
+		for (i = 0; i < v->u.so.shape->size; ++i) {
+			lept_free(&v->u.so.v[i]);
+		}
+		v->u.so.shape = &v->u.so.shape->tree->root;  /* 仍在同一棵树中，引用不变 */
+		return;
+	}
 	for (i = 0; i < v->u.o.size; ++i) {
 		free(v->u.o.m[i].k);
 		v->u.o.m[i].k = NULL;  /* free() 后要将指针置空 */
@@ -844,25 +4658,28 @@ void lept_clear_object(lept_value* v) {
 
 const char* lept_get_object_key(const lept_value* v, size_t index) {
 	assert(v != NULL && v->type == LEPT_OBJECT);
-	assert(index < v->u.o.size);
-	return v->u.o.m[index].k;
+	assert(index < lept_get_object_size(v));
+	return IS_SHAPED(v) ? v->u.so.shape->list->keys[index].k : v->u.o.m[index].k;
 }
 
 size_t lept_get_object_key_length(const lept_value* v, size_t index) {
 	assert(v != NULL && v->type == LEPT_OBJECT);
-	assert(index < v->u.o.size);
-	return v->u.o.m[index].klen;
+	assert(index < lept_get_object_size(v));
+	return IS_SHAPED(v) ? v->u.so.shape->list->keys[index].klen : v->u.o.m[index].klen;
 }
 
 lept_value* lept_get_object_value(const lept_value* v, size_t index) {
 	assert(v != NULL && v->type == LEPT_OBJECT);
-	assert(index < v->u.o.size);
-	return &v->u.o.m[index].v;
+	assert(index < lept_get_object_size(v));
+	return IS_SHAPED(v) ? &v->u.so.v[index] : &v->u.o.m[index].v;
 }
 
 size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen) {
 	size_t i;
 	assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+	if (IS_SHAPED(v)) {
+		return lept_shape_find(v->u.so.shape, key, klen, lept_hash_key(key, klen));
+	}
 	for (i = 0; i < v->u.o.size; ++i) {
 		if (v->u.o.m[i].klen == klen && memcmp(v->u.o.m[i].k, key, klen) == 0) {
 			return i;
@@ -873,14 +4690,27 @@ size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen)
 
 lept_value* lept_find_object_value(const lept_value* v, const char* key, size_t klen) {
 	size_t index = lept_find_object_index(v, key, klen);
-	return index != LEPT_KEY_NOT_EXIST ? &v->u.o.m[index].v : NULL;
+	return index != LEPT_KEY_NOT_EXIST ? lept_get_object_value(v, index) : NULL;
 }
 
-lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen) {
-	/* 先搜寻是否存在现有的键，若存在则直接返回该值的指针，不存在时才新增 */
-	assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
-	lept_value* ret = lept_find_object_value(v, key, klen);
-	if (ret != NULL) return ret;
+static lept_value* lept_append_object_value(lept_value* v, const char* key, size_t klen, unsigned hash) {
+	/* 在末尾新增一个成员，调用者需确认键不存在 */
+	size_t size;
+	LEPT_TOUCH(v);
+	if (IS_SHAPED(v)) {
+		lept_shape* next = lept_shape_child(v->u.so.shape, key, klen, hash);
+		if (next != NULL) {
+			/* 沿已有的转移边走到子形状，值数组按原来的倍增规则扩容 */
+			size = v->u.so.shape->size;
+			if (size == v->u.so.capacity) {
+				lept_reserve_object(v, v->u.so.capacity == 0 ? 1 : 2 * v->u.so.capacity);
+			}
+			v->u.so.shape = next;
+			lept_init(&v->u.so.v[size]);
+			return &v->u.so.v[size];
+		}
+		lept_unshape_object(v);
+	}
 	if (v->u.o.size == v->u.o.capacity) {
 		lept_reserve_object(v, v->u.o.capacity == 0 ? 1 : 2 * v->u.o.capacity);
 	}
@@ -892,19 +4722,226 @@ lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen) {
 	return &v->u.o.m[v->u.o.size++].v;
 }
 
+lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen) {
+	/* 先搜寻是否存在现有的键，若存在则直接返回该值的指针，不存在时才新增 */
+	lept_value* ret;
+	unsigned hash;
+	assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+	if (IS_SHAPED(v)) {
+		size_t index = lept_shape_find(v->u.so.shape, key, klen, hash = lept_hash_key(key, klen));
+		if (index != LEPT_KEY_NOT_EXIST) return &v->u.so.v[index];
+		return lept_append_object_value(v, key, klen, hash);
+	}
+	ret = lept_find_object_value(v, key, klen);
+	if (ret != NULL) return ret;
+	return lept_append_object_value(v, key, klen, lept_hash_key(key, klen));
+}
+
 void lept_remove_object_value(lept_value* v, size_t index) {
-	assert(v != NULL && v->type == LEPT_OBJECT && index < v->u.o.size);
+	assert(v != NULL && v->type == LEPT_OBJECT && index < lept_get_object_size(v));
+	LEPT_TOUCH(v);
+	if (IS_SHAPED(v)) {
+		lept_shape* shape = v->u.so.shape;
+		if (index + 1 == shape->size) {
+			/* 删除最后一个成员只需退回父形状，其他位置则退回 lept_member 布局 */
+			lept_free(&v->u.so.v[index]);
+			v->u.so.shape = shape->parent;  /* 仍在同一棵树中，引用不变 */
+			return;
+		}
+		lept_unshape_object(v);
+	}
 	free(v->u.o.m[index].k);
 	/*
 		以下两步可以不在这里做：
 			v->u.o.m[index].k = NULL;
 			v->u.o.m[index].klen = 0;
-		因为后面 memcpy() 的时候，会覆盖掉这两行代码修改的地方，所以写不写都一样
+		因为后面 memmove() 的时候，会覆盖掉这两行代码修改的地方，所以写不写都一样
 	*/
 	lept_free(&v->u.o.m[index].v);
-	memcpy(&v->u.o.m[index], &v->u.o.m[index + 1], (v->u.o.size - 1 - index) * sizeof(lept_member));
+	memmove(&v->u.o.m[index], &v->u.o.m[index + 1], (v->u.o.size - 1 - index) * sizeof(lept_member));
 	/* 内存块移动后，需要将最后一个块初始化，否则仍然保存着之前的内容 */
 	v->u.o.m[--v->u.o.size].k = NULL;
 	v->u.o.m[v->u.o.size].klen = 0;
 	lept_init(&v->u.o.m[v->u.o.size].v);
-}
\ No newline at end of file
+}
+
+lept_key lept_key_make(const char* key, size_t klen) {
+	lept_key ret;
+	assert(key != NULL);
+	ret.k = key;
+	ret.klen = klen;
+	ret.hash = lept_hash_key(key, klen);
+	ret.hint = 0;
+	return ret;
+}
+
+size_t lept_find_object_index_by_key(const lept_value* v, lept_key* key) {
+	/*
+		先试上一次命中的下标：同一批形状相同的对象（例如数组里的记录），
+		同一个键通常在同一位置，这时只需一次比较；不命中时，
+		形状布局用预先算好的哈希查表，lept_member 布局退回线性查找
+	*/
+	size_t index;
+	assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+	index = key->hint;
+	if (IS_SHAPED(v)) {
+		const lept_shape* shape = v->u.so.shape;
+		if (index < shape->size && lept_shape_key_equal(&shape->list->keys[index], key->k, key->klen, key->hash)) {
+			return index;
+		}
+		index = lept_shape_find(v->u.so.shape, key->k, key->klen, key->hash);
+	} else {
+		if (index < v->u.o.size && v->u.o.m[index].klen == key->klen &&
+			memcmp(v->u.o.m[index].k, key->k, key->klen) == 0) {
+			return index;
+		}
+		index = lept_find_object_index(v, key->k, key->klen);
+	}
+	if (index != LEPT_KEY_NOT_EXIST) {
+		key->hint = index;
+	}
+	return index;
+}
+
+lept_value* lept_find_object_value_by_key(const lept_value* v, lept_key* key) {
+	size_t index = lept_find_object_index_by_key(v, key);
+	return index != LEPT_KEY_NOT_EXIST ? lept_get_object_value(v, index) : NULL;
+}
+
+lept_value* lept_set_object_value_by_key(lept_value* v, lept_key* key) {
+	lept_value* ret = lept_find_object_value_by_key(v, key);
+	if (ret != NULL) return ret;
+	key->hint = lept_get_object_size(v);
+	return lept_append_object_value(v, key->k, key->klen, key->hash);
+}
+
+/*
+	JSON Pointer：段的内容存放在 lept_pointer 之后的同一块内存里，
+	对象用 lept_key 查找（带哈希和命中位置提示），数组直接用编译时转好的下标。
+*/
+
+typedef struct {
+	lept_key key;
+	size_t index;	/* 段是数组下标时为下标，否则为 (size_t)-1 */
+}lept_pointer_token;
+
+struct lept_pointer {
+	size_t size;	/* 段数 */
+	lept_pointer_token* t;
+};
+
+lept_pointer* lept_pointer_compile(const char* pointer) {
+	size_t len, klen, size = 0;
+	const char* p;
+	char* key;
+	lept_pointer* ret;
+	assert(pointer != NULL);
+	if (*pointer != '/' && *pointer != '\0') {
+		return NULL;
+	}
+	for (p = pointer; *p != '\0'; ++p) {
+		size += *p == '/';
+	}
+	len = (size_t)(p - pointer);
+	/* 还原后的段不会比原来长，每段再加一个 '\0' */
+	ret = (lept_pointer*)malloc(sizeof(lept_pointer) + size * sizeof(lept_pointer_token) + len + size);
+	ret->size = size;
+	ret->t = (lept_pointer_token*)(ret + 1);
+	key = (char*)(ret->t + size);
+	for (p = pointer, size = 0; *p == '/'; ++size) {
+		if (!lept_path_segment(&p, key, &klen)) {
+			free(ret);
+			return NULL;
+		}
+		key[klen] = '\0';
+		ret->t[size].key = lept_key_make(key, klen);
+		ret->t[size].index = lept_path_index(key, klen);
+		key += klen + 1;
+	}
+	return ret;
+}
+
+void lept_pointer_free(lept_pointer* p) {
+	free(p);
+}
+
+static lept_value* lept_pointer_step(const lept_value* v, lept_pointer_token* t) {
+	if (v->type == LEPT_OBJECT) {
+		return lept_find_object_value_by_key(v, &t->key);
+	}
+	if (v->type == LEPT_ARRAY && t->index < lept_get_array_size(v) && !IS_PACKED(v)) {
+		return lept_get_array_element(v, t->index);  /* 紧凑数组的元素没有 lept_value */
+	}
+	return NULL;
+}
+
+lept_value* lept_pointer_get(const lept_value* v, lept_pointer* p) {
+	size_t i;
+	assert(v != NULL && p != NULL);
+	for (i = 0; i < p->size && v != NULL; ++i) {
+		v = lept_pointer_step(v, &p->t[i]);
+	}
+	return (lept_value*)v;
+}
+
+lept_value* lept_pointer_set(lept_value* v, lept_pointer* p) {
+	size_t i;
+	assert(v != NULL && p != NULL);
+	for (i = 0; i < p->size; ++i) {
+		lept_pointer_token* t = &p->t[i];
+		if (v->type == LEPT_NULL) {
+			lept_set_object(v, 0);
+		}
+		if (v->type == LEPT_OBJECT) {
+			v = lept_set_object_value_by_key(v, &t->key);
+		} else if (v->type == LEPT_ARRAY && t->index < lept_get_array_size(v)) {
+			lept_unpack_array(v);
+			v = lept_get_array_element(v, t->index);
+		} else if (v->type == LEPT_ARRAY && (t->index == lept_get_array_size(v) || (t->key.klen == 1 && t->key.k[0] == '-'))) {
+			v = lept_pushback_array_element(v);
+		} else {
+			return NULL;
+		}
+	}
+	return v;
+}
+
+static int lept_pointer_token_equal(const lept_pointer_token* a, const lept_pointer_token* b) {
+	return a->key.hash == b->key.hash && a->key.klen == b->key.klen && memcmp(a->key.k, b->key.k, a->key.klen) == 0;
+}
+
+size_t lept_pointer_get_batch(const lept_value* v, lept_pointer* const* pointers, size_t n, lept_value** out) {
+	/*
+		path[d] 是前一个指针前 d 段所指的值，reached 是其中有效的个数，
+		下一个指针与前一个指针的公共前缀不超过 reached 时直接从 path 中取
+	*/
+	const lept_value** path;
+	size_t i, d, depth = 0, reached = 0, found = 0;
+	const lept_pointer* prev = NULL;
+	assert(v != NULL && (pointers != NULL || n == 0) && (out != NULL || n == 0));
+	for (i = 0; i < n; ++i) {
+		depth = pointers[i]->size > depth ? pointers[i]->size : depth;
+	}
+	path = (const lept_value**)malloc((depth + 1) * sizeof(lept_value*));
+	path[0] = v;
+	for (i = 0; i < n; ++i) {
+		lept_pointer* p = pointers[i];
+		d = 0;
+		if (prev != NULL) {
+			while (d < p->size && d < prev->size && d + 1 < reached && lept_pointer_token_equal(&p->t[d], &prev->t[d])) {
+				++d;
+			}
+		}
+		for (reached = d + 1; d < p->size; ++d) {
+			if ((path[d + 1] = lept_pointer_step(path[d], &p->t[d])) == NULL) {
+				break;
+			}
+			++reached;
+		}
+		out[i] = d == p->size ? (lept_value*)path[d] : NULL;
+		found += out[i] != NULL;
+		prev = p;
+	}
+	free(path);
+	return found;
+}
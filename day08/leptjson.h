@@ -14,15 +14,20 @@ typedef enum {
 */
 typedef struct lept_value lept_value;
 typedef struct lept_member lept_member;
+typedef struct lept_shape lept_shape;  /* ״ leptjson.c  */
 
 struct lept_value {
 	union {
 		struct { lept_member* m; size_t size; size_t capacity; }o;		/* object: members, member count, capacity */
+		struct { lept_value* v; lept_shape* shape; size_t capacity; }so;	/* shaped object: values, shape (keys), capacity */
 		struct { lept_value* e; size_t size; size_t capacity; }a;		/* array:  elements, element count, capacity */
+		struct { double* d; size_t size; size_t capacity; }pa;			/* packed array: numbers only, element count, capacity */
+		struct { lept_value** b; size_t size; size_t capacity; }sa;		/* segmented array: block index, element count, capacity */
 		struct { char* s; size_t len; }s;								/* string: null-terminated string, string length */
 		double n;														/* number */
 	}u;
 	lept_type type;
+	unsigned flags;  /* ڲʹõĴ洢ʽǣ lept_init()  */
 };
 
 struct lept_member {
@@ -35,6 +40,22 @@ struct lept_member {
 	*/
 };
 
+/*	ϣ˳ͬĶһ״shapeֻ״ֵָ飬
+	ÿ󶼸һ״ɽÿνһ״޸ģ
+	Բͬ߳̿ͬʱԵĵͬʱͬһĵ LEPT_SHAPE_MAX_KEYS
+	ļ״ûжӦ״ɾ˷ĩβĳԱ˻ lept_member ֡
+	lept_set_object() ½Ķֱʹ lept_member ֡
+*/
+
+/*	ԤȱõļͬһʱֻһγȺ͹ϣֵ
+	hint ¼һе±꣬״ͬĶͬһλ
+*/
+typedef struct {
+	const char* k; size_t klen;  /* key string (not owned), key string length */
+	unsigned hash;				 /* precomputed hash of key */
+	size_t hint;				 /* index of last match */
+} lept_key;
+
 enum {
 	LEPT_PARSE_OK = 0,						 /* 						*/
 	LEPT_PARSE_EXPECT_VALUE,				 /* ֻпհףȱֵ			*/
@@ -49,15 +70,147 @@ enum {
 	LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, /* ȱٶŻ			*/
 	LEPT_PARSE_MISS_KEY,					 /* ȱ key ؼ				*/
 	LEPT_PARSE_MISS_COLON,					 /* ȱð						*/
-	LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET   /* ȱٶŻ߻			*/
+	LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET,  /* ȱٶŻ߻			*/
+	LEPT_PARSE_TOO_DEEP,					 /* Ƕײɨ		*/
+	LEPT_PARSE_INVALID_UTF8,				 /* ַǺϷ UTF-8		*/
+	LEPT_PARSE_INVALID_POINTER				 /* ·ǺϷ JSON Pointer	*/
 };
 
 /*  lept_free()  v ͣڵзʺ֮ǰǱʼ */
-#define lept_init(v) do { (v)->type = LEPT_NULL; } while (0)
+#define lept_init(v) do { (v)->type = LEPT_NULL; (v)->flags = 0; } while (0)
 
 int lept_parse(lept_value* v, const char* json);
+#define LEPT_PARSE_CHECK_UTF8 0x1	/* lept_parse_ex() ѡַǺϷ UTF-8򷵻 LEPT_PARSE_INVALID_UTF8 */
+
+#define LEPT_PARSE_SKIP_UNCHECKED 0x2	/* lept_parse_excluding() ѡֵ﷨ */
+
+#define LEPT_PARSE_PACK_ARRAYS 0x4	/* lept_parse_ex() ѡȫֵĳ double[] մ洢 */
+
+int lept_parse_ex(lept_value* v, const char* json, int flags, size_t* err_offset);	/* ʱ *err_offset Ϊֽƫƣɴ NULL */
+
+/*	ʱ paths ֵָȥЩԱȥЩԪأ֮Ԫ±ǰƣ
+	· JSON PointerRFC 6901 "/debug""/items/0/raw"Ϊ "*" ʱƥ±ꡣ
+	ֵ lept_skip_value() ɨ裬ڴ棻ȱʡ԰ lept_parse() ﷨飬ͬ
+	· '/' ͷ"" ⣩ "~0""~1"  '~' ʱ LEPT_PARSE_INVALID_POINTER
+*/
+int lept_parse_excluding(lept_value* v, const char* json, const char* const* paths, size_t npaths, int flags);
+
+/*	 lept_parse_excluding() ෴ֻ paths ֵָǵֵͨ lept_value
+	·յƥֵʱҲjson  '\0' βlen ĳȣʡȥ strlen()
+	·Ϸʱ lept_parse_excluding() һ LEPT_PARSE_INVALID_POINTER
+*/
+int lept_parse_projected(lept_value* v, const char* json, size_t len, const char* const* paths, size_t npaths);
+
+/*	JSONPath Ӽ$.name['name'].*  [*][n][start:end:step]ָ֧
+	ԼЩǰ .. ĵݹ½ "$.events[*].user.id""$..id" LEPT_JSONPATH_MAX_STEPS 
+	lept_jsonpath_compile() ﷨ʱ NULL
+	lept_jsonpath_eval() ĵ˳ÿƥֵ fnv  fn غ󼴱ͷţҪʱ lept_move() ȡߣ
+	fn ط 0 ʱֹͣټ֮ݡƥ lept_skip_value() ڴ档
+	json  '\0' βlen ĳȣֵ lept_parse() ͬ
+*/
+typedef struct lept_jsonpath lept_jsonpath;
+typedef int (*lept_match_fn)(void* ud, lept_value* v);
+
+lept_jsonpath* lept_jsonpath_compile(const char* path);
+void lept_jsonpath_free(lept_jsonpath* path);
+int lept_jsonpath_eval(const lept_jsonpath* path, const char* json, size_t len, lept_match_fn fn, void* ud);
+
+/*	 json ͷһֵ֮ǰпհף*offset Ϊֵ֮λãʱΪ
+	validate Ϊ 0 ʱֻƥźţ﷨ҲǷԡ
+*/
+int lept_skip_value(const char* json, size_t len, int validate, size_t* offset);
+void lept_get_error_position(const char* json, size_t offset, size_t* line, size_t* column);	/* ƫƼкźкţֽڣ 1 ʼ */
 char* lept_stringify(const lept_value* v, size_t* length);  /* length ǿѡģ洢 JSON ĳȣ NULL ɺԴ˲ʹ÷踺 free() ͷڴ */
 
+typedef struct {
+	unsigned indent;		/* ÿַ0 ʾ */
+	char indent_char;		/* ' '  '\t' */
+	int space_after_colon;	/* ðźһո */
+	int crlf;				/* ʹ "\r\n"ʹ "\n" */
+}lept_stringify_options;
+
+char* lept_stringify_ex(const lept_value* v, const lept_stringify_options* opts, size_t* length);  /* opts Ϊ NULL ʱ lept_stringify() ͬ */
+
+/*	淶ʽRFC 8785 JSON Canonicalization Schemeȵ JSON ǵõֽͬڣڼϣ
+	ļ UTF-16 Ԫְ ECMAScript Ĺʽ 1e+211e-7-0  0
+	ַֻתַ޸Ҳ v÷ lept_stringify() ͬ
+*/
+char* lept_stringify_canonical(const lept_value* v, size_t* length);
+
+/*	 lept_value ֻ lept_parse() ﷨鲢ɿհףַԭơ
+	ֵ lept_parse() ͬǶ׳ LEPT_SCAN_MAX_DEPTH ʱ LEPT_PARSE_TOO_DEEP
+	lept_minify() ȥпհףд÷ṩ outout Ҫ len + 1 ֽڣ '\0' β
+	lept_reformat()  opts NULL ʱ lept_minify() ͬɹʱ *out ɵ÷ free() ͷţʧʱΪ NULL
+*/
+int lept_validate(const char* json, size_t len, size_t* err_offset);	/* ֻ飬ڴ棻ʱ *err_offset Ϊֽƫƣɴ NULL */
+int lept_minify(const char* json, size_t len, char* out, size_t* length);
+int lept_reformat(const char* json, size_t len, const lept_stringify_options* opts, char** out, size_t* length);
+
+/*	߳ɣ lept_stringify() ͬԪغֶܶν threads ߳ƴӣ
+	threads Ϊ 0 ʱʹ CPU СȻɡڼ̲߳޸ v
+*/
+char* lept_stringify_parallel(const lept_value* v, unsigned threads, size_t* length);
+
+/*	ʽɣдСΪ buf_size Ļ 0 ʹĬϴС˾ͽ write ص
+	ϳֱַӽصص 0 ʾɹط 0 ʱֹͣɣ
+	lept_stringify_to() ظֵ
+*/
+typedef int (*lept_write_fn)(void* ud, const char* data, size_t len);
+int lept_stringify_to(const lept_value* v, lept_write_fn write, void* ud, size_t buf_size);
+int lept_write_fd(void* ud, const char* data, size_t len);		/* ud ָ int ļ write() дȫ */
+int lept_write_file(void* ud, const char* data, size_t len);	/* ud Ϊ FILE* fwrite() */
+
+/*	ʽд lept_value ˳ֱɽյ JSON
+	write Ϊ NULL ʱ lept_stringify_to() һصдڴ棬 lept_writer_finish() ȡá
+	Զӣ˳򣨼ֻڶСԵȣֻڵ԰汾 assert() 顣
+	lept_writer_finish() ͷд write Ĵдڴʱ *json ɵ÷ free() ͷţ
+	ʹ write ʱ *json Ϊ NULL*length Ϊ 0json  length ɴ NULL
+*/
+typedef struct lept_writer lept_writer;
+
+lept_writer* lept_writer_create(lept_write_fn write, void* ud, size_t buf_size);
+void lept_writer_begin_array(lept_writer* w);
+void lept_writer_end_array(lept_writer* w);
+void lept_writer_begin_object(lept_writer* w);
+void lept_writer_end_object(lept_writer* w);
+void lept_writer_key(lept_writer* w, const char* key, size_t klen);
+void lept_writer_string(lept_writer* w, const char* s, size_t len);
+void lept_writer_number(lept_writer* w, double n);
+void lept_writer_boolean(lept_writer* w, int b);
+void lept_writer_null(lept_writer* w);
+void lept_writer_value(lept_writer* w, const lept_value* v);	/* д v */
+int lept_writer_finish(lept_writer* w, char** json, size_t* length);
+
+/*	дṩĻڴ档 snprintf() һ JSON ĳȣ '\0'
+	ֵС cap ʱ buf  '\0' β JSON buf 壬Ҫ ֵ + 1 ֽڡ
+	lept_stringify_size() ֻ㳤ȡ
+*/
+size_t lept_stringify_into(const lept_value* v, char* buf, size_t cap);
+size_t lept_stringify_size(const lept_value* v);
+
+/*	 iovec бֱӽ writev()/sendmsg()ṹԵƬд *scratch
+	ϳҲתַƬֱ v еĴ洢ƣ v ޸ĻͷǰЧ
+	ص *scratch ɵ÷ free() ͷš
+*/
+typedef struct {
+	const char* base;
+	size_t len;
+}lept_iovec;
+
+lept_iovec* lept_stringify_iovec(const lept_value* v, size_t* count, char** scratch);
+int lept_writev_fd(int fd, const lept_iovec* iov, size_t count);	/*  writev() дȫƬΣɹ 0 */
+
+/*	ɣ汣һεϴû޸ĹֱӴиƣ¸ʽ
+	ֻոʽصַɻУһεûͷŻǰЧ
+	ÿ lept_value ֻһʹáv ϻ¼ϴû޸Ĺıǣ
+	 v  const޸ v һ̶ܺ߳ͬһĲͬʱС
+*/
+typedef struct lept_stringify_cache lept_stringify_cache;
+
+lept_stringify_cache* lept_stringify_cache_create(void);
+void lept_stringify_cache_free(lept_stringify_cache* cache);
+const char* lept_stringify_cached(lept_value* v, lept_stringify_cache* cache, size_t* length);
+
 void lept_copy(lept_value* dst, const lept_value* src);
 void lept_move(lept_value* dst, lept_value* src);
 void lept_swap(lept_value* lhs, lept_value* rhs);
@@ -90,6 +243,31 @@ lept_value* lept_pushback_array_element(lept_value* v);
 void lept_popback_array_element(lept_value* v);
 lept_value* lept_insert_array_element(lept_value* v, size_t index);
 void lept_erase_array_element(lept_value* v, size_t index, size_t count);
+/*	 src  [src_from, src_from + count) 滻 dst  [index, index + delete_count)
+	move  0 ʱתԪضƣԪ֮ src ɾȥsrc Ծ dst
+	׷һΣindex = dst ĴСdelete_count = 0ƶһΣsrc  dst ͬ move = 1
+*/
+void lept_splice_array(lept_value* dst, size_t index, size_t delete_count, lept_value* src, size_t src_from, size_t count, int move);
+
+/*	ֿ洢飺Ԫشڹ̶СĿУֻӿ飬Ԫزᱻᶯ
+	β׷ӲơԪָ뱣Ч± O(1)ʺԪغܶࡢ׷ӵ顣
+*/
+void lept_set_segmented_array(lept_value* v, size_t capacity);
+
+/*	ȫֵĳ double[] մ洢ʱָ LEPT_PARSE_PACK_ARRAYS Զʶ𣩣
+	㸴Ƶضȡۺϼ㡣մ洢Ԫû lept_value lept_get_array_number() ֵȡ
+	lept_get_array_element() ڽ飬ҪԪָʱȵ lept_unpack_array()
+	lept_pushback_array_element()lept_insert_array_element() ȻԶתͨ洢
+	֮ǰ lept_get_array_doubles() صָ֮ʧЧ
+*/
+void lept_set_array_doubles(lept_value* v, const double* d, size_t n);
+int lept_pack_array(lept_value* v);						/* ȫתΪմ洢Ƿɹ */
+void lept_unpack_array(lept_value* v);					/* մ洢תͨ洢洢 */
+const double* lept_get_array_doubles(const lept_value* v);	/* ǽմ洢ʱ NULL */
+double lept_get_array_number(const lept_value* v, size_t index);	/* κδ洢ãԪر */
+double lept_get_array_sum(const lept_value* v);
+double lept_get_array_min(const lept_value* v);
+double lept_get_array_max(const lept_value* v);
 
 void lept_set_object(lept_value* v, size_t capacity);
 size_t lept_get_object_size(const lept_value* v);
@@ -105,4 +283,37 @@ lept_value* lept_find_object_value(const lept_value* v, const char* key, size_t
 lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen);
 void lept_remove_object_value(lept_value* v, size_t index);
 
+lept_key lept_key_make(const char* key, size_t klen);  /* lept_key ֻ keyƣʹڼ key Ч */
+size_t lept_find_object_index_by_key(const lept_value* v, lept_key* key);
+lept_value* lept_find_object_value_by_key(const lept_value* v, lept_key* key);
+lept_value* lept_set_object_value_by_key(lept_value* v, lept_key* key);
+
+/*	õ JSON PointerRFC 6901 "/a/b/0/c"ÿεļԤùϣ±Ԥתɷʹá
+	lept_pointer_compile() ﷨ʱ NULLlept_pointer ¼˲ʾҪڶ߳ͬʱʹͬһ
+	lept_pointer_get() ֵָʱ NULLԪû lept_valueҲ NULL
+	lept_pointer_set() ֵָȱٵĶԱᱻΪ null;е null ᱻĳɿն
+	±СΪ "-" ʱĩβԪأ޷ʱ NULL
+	lept_pointer_get_batch()  pointers[i] ֵд out[i]ǰһָͬǰ׺ظң
+	԰ǰ׺Чãҵĸ
+*/
+typedef struct lept_pointer lept_pointer;
+
+lept_pointer* lept_pointer_compile(const char* pointer);
+void lept_pointer_free(lept_pointer* p);
+lept_value* lept_pointer_get(const lept_value* v, lept_pointer* p);
+lept_value* lept_pointer_set(lept_value* v, lept_pointer* p);
+size_t lept_pointer_get_batch(const lept_value* v, lept_pointer* const* pointers, size_t n, lept_value** out);
+
+/*	SIMD ںˣַɨ衢ƥ䡢հۺϣļȱʡڵһʹʱ CPU ѡ
+	 LEPT_SIMD=scalar  sse2 Խʱ LEPT_SIMD_LEVEL ̶Ϊü
+	lept_set_simd_level() ǿʹĳ𣨳 CPU ֵ֧ļʱȡ߿üС 0 ʱ¼⣩
+	ʵʹõļӦ߳ʹñ֮ǰá
+*/
+typedef enum {
+	LEPT_SIMD_SCALAR, LEPT_SIMD_SSE2, LEPT_SIMD_AVX2
+} lept_simd_level;
+
+int lept_get_simd_level(void);
+int lept_set_simd_level(int level);
+
 #endif /* LEPTJSON_H__ */
\ No newline at end of file
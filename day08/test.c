@@ -81,6 +81,7 @@ static void test_parse_number() {
 	TEST_NUMBER(0.0, "-0.0");
 	TEST_NUMBER(1.0, "1");
 	TEST_NUMBER(-1.0, "-1");
+	TEST_NUMBER(100.0, "100");
 	TEST_NUMBER(1.5, "1.5");
 	TEST_NUMBER(-1.5, "-1.5");
 	TEST_NUMBER(3.1416, "3.1416");
@@ -231,10 +232,13 @@ static void test_parse_object() {
 #define TEST_ERROR(error, json)\
 	do {\
 		lept_value v;\
+		char out[sizeof(json)];\
 		lept_init(&v);\
 		v.type = LEPT_FALSE;\
 		EXPECT_EQ_INT(error, lept_parse(&v, json));\
 		EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+		EXPECT_EQ_INT(error, lept_minify(json, sizeof(json) - 1, out, NULL));\
+		EXPECT_EQ_INT(error, lept_validate(json, sizeof(json) - 1, NULL));\
 		lept_free(&v);\
 	} while (0)
 
@@ -269,6 +273,9 @@ static void test_parse_root_not_singular() {
 	TEST_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "0123"); /* after zero should be '.' , 'E' , 'e' or nothing */
 	TEST_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "0x0");
 	TEST_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "0x123");
+	TEST_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "01e823"); /* "0" ֮Ĳֲ */
+	TEST_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "-01e823");
+	TEST_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "0x1p2000");
 }
 
 static void test_parse_number_too_big() {
@@ -324,6 +331,7 @@ static void test_parse_miss_comma_or_square_bracket() {
 	TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1}");
 	TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2");
 	TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[[]");
+	TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1, 02e308]");
 }
 
 static void test_parse_miss_key() {
@@ -349,6 +357,275 @@ static void test_parse_miss_comma_or_curly_bracket() {
 	TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":{}");
 }
 
+#define TEST_ERROR_POSITION(error, json, offset, line, column)\
+	do {\
+		lept_value v;\
+		size_t o, l, c;\
+		lept_init(&v);\
+		EXPECT_EQ_INT(error, lept_parse_ex(&v, json, 0, &o));\
+		EXPECT_EQ_SIZE_T(offset, o);\
+		lept_get_error_position(json, o, &l, &c);\
+		EXPECT_EQ_SIZE_T(line, l);\
+		EXPECT_EQ_SIZE_T(column, c);\
+		EXPECT_EQ_INT(error, lept_validate(json, sizeof(json) - 1, &o));\
+		EXPECT_EQ_SIZE_T(offset, o);\
+		lept_free(&v);\
+	} while (0)
+
+#define TEST_UTF8(error, json)\
+	do {\
+		lept_value v;\
+		lept_init(&v);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+		lept_free(&v);\
+		EXPECT_EQ_INT(error, lept_parse_ex(&v, json, LEPT_PARSE_CHECK_UTF8, NULL));\
+		lept_free(&v);\
+	} while (0)
+
+static void test_parse_invalid_utf8() {
+	lept_value v;
+	TEST_UTF8(LEPT_PARSE_OK, "\"\xc2\xa2\xe2\x82\xac\xf0\x90\x8d\x88\xed\x9f\xbf\xee\x80\x80\xf4\x8f\xbf\xbf\"");
+	TEST_UTF8(LEPT_PARSE_OK, "{\"\xc3\xa9\":\"\\u00e9\\uD834\\uDD1E\"}");
+	TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\x80\"");				/* ֽ */
+	TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xc0\xaf\"");			/* ʽ */
+	TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xe0\x80\xaf\"");
+	TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xf0\x80\x80\xaf\"");
+	TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xed\xa0\x80\"");		/*  */
+	TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xf4\x90\x80\x80\"");	/*  U+10FFFF */
+	TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xf5\x80\x80\x80\"");
+	TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "\"\xe2\x82\"");			/* ض */
+	TEST_UTF8(LEPT_PARSE_INVALID_UTF8, "{\"\xff\":1}");
+	TEST_UTF8(LEPT_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uDC00\"");
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UTF8, lept_parse_ex(&v, "[\"\xe2\x82", LEPT_PARSE_CHECK_UTF8, NULL));
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UTF8, lept_parse_ex(&v, "[\"ab\xe2\x82x\"]", LEPT_PARSE_CHECK_UTF8, NULL));
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+}
+
+static void test_parse_error_position() {
+	TEST_ERROR_POSITION(LEPT_PARSE_EXPECT_VALUE, "", 0, 1, 1);
+	TEST_ERROR_POSITION(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1,\n \"b\":2\r\n  \"c\":3}", 18, 3, 3);
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_VALUE, "[1,\n tru]", 8, 2, 5);
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_VALUE, "[1,\n -x]", 5, 2, 2);
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_STRING_ESCAPE, "[\"ab\\x\"]", 5, 1, 6);
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_STRING_CHAR, "\"a\x01\"", 2, 1, 3);
+	TEST_ERROR_POSITION(LEPT_PARSE_MISS_QUOTATION_MARK, "[\"abc", 5, 1, 6);
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_UNICODE_HEX, "\"\\u12\"", 2, 1, 3);
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uE000\"", 12, 1, 13);
+	TEST_ERROR_POSITION(LEPT_PARSE_ROOT_NOT_SINGULAR, "[1]\n\n x", 6, 3, 2);
+	TEST_ERROR_POSITION(LEPT_PARSE_ROOT_NOT_SINGULAR, "0123", 1, 1, 2);
+	TEST_ERROR_POSITION(LEPT_PARSE_ROOT_NOT_SINGULAR, "01e823", 1, 1, 2);
+	TEST_ERROR_POSITION(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[0,02e308]", 4, 1, 5);
+}
+
+#define TEST_SKIP(error, json, validate, offset)\
+	do {\
+		size_t o;\
+		EXPECT_EQ_INT(error, lept_skip_value(json, sizeof(json) - 1, validate, &o));\
+		EXPECT_EQ_SIZE_T(offset, o);\
+	} while (0)
+
+static void test_skip_value() {
+	TEST_SKIP(LEPT_PARSE_OK, " 123 ,", 1, 4);
+	TEST_SKIP(LEPT_PARSE_OK, " 123 ,", 0, 4);
+	TEST_SKIP(LEPT_PARSE_OK, "\"a\\\"]}\" ]", 1, 7);
+	TEST_SKIP(LEPT_PARSE_OK, "\"a\\\"]}\" ]", 0, 7);
+	TEST_SKIP(LEPT_PARSE_OK, "{\"a\":[1,{\"b\":\"}\"}],\"c\":null}, 2", 1, 28);
+	TEST_SKIP(LEPT_PARSE_OK, "{\"a\":[1,{\"b\":\"}\"}],\"c\":null}, 2", 0, 28);
+	TEST_SKIP(LEPT_PARSE_OK, "[[[]]]]", 0, 6);
+	TEST_SKIP(LEPT_PARSE_INVALID_VALUE, "[1,tru]", 1, 6);
+	TEST_SKIP(LEPT_PARSE_OK, "[1,tru]", 0, 7);	/* ﷨ */
+	TEST_SKIP(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2]", 1, 3);
+	TEST_SKIP(LEPT_PARSE_MISS_QUOTATION_MARK, "[\"abc", 0, 5);
+	TEST_SKIP(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":[1]", 0, 8);
+	TEST_SKIP(LEPT_PARSE_EXPECT_VALUE, "  ", 1, 2);
+	TEST_SKIP(LEPT_PARSE_EXPECT_VALUE, "  ", 0, 2);
+	TEST_SKIP(LEPT_PARSE_INVALID_VALUE, "]", 0, 0);
+}
+
+#define TEST_EXCLUDING(expect, json, paths, flags)\
+	do {\
+		lept_value v;\
+		char* json2;\
+		size_t length;\
+		lept_init(&v);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_excluding(&v, json, paths, sizeof(paths) / sizeof(paths[0]), flags));\
+		json2 = lept_stringify(&v, &length);\
+		EXPECT_EQ_STRING(expect, json2, length);\
+		lept_free(&v);\
+		free(json2);\
+	} while (0)
+
+static void test_parse_excluding() {
+	static const char json[] = "{\"id\":1,\"debug\":{\"x\":[1,2,{\"y\":\"z\"}]},"
+		"\"items\":[{\"k\":1,\"raw\":[1,2]},{\"k\":2,\"raw\":3},{\"k\":3,\"raw\":\"s\"}],\"a/b\":true,\"m~n\":null,\"z\":false}";
+	static const char* const paths[] = { "/debug", "/items/*/raw", "/items/1", "/a~1b", "/m~0n" };
+	static const char* const nested[] = { "/*/raw", "/a/b" };
+	static const char* const index[] = { "/1", "/01" };
+	static const char* const root[] = { "" };
+	static const char* const none[] = { "/x" };
+	static const char* const bad[] = { "/a", "/x~2", "a", "/b/~" };
+	lept_value v;
+
+	TEST_EXCLUDING("{\"id\":1,\"items\":[{\"k\":1},{\"k\":3}],\"z\":false}", json, paths, 0);
+	TEST_EXCLUDING("{\"id\":1,\"items\":[{\"k\":1},{\"k\":3}],\"z\":false}", json, paths, LEPT_PARSE_SKIP_UNCHECKED);
+	/* "*" Ҳƥо·ļ */
+	TEST_EXCLUDING("{\"a\":{\"c\":3},\"b\":{\"b\":5}}", "{\"a\":{\"raw\":1,\"b\":2,\"c\":3},\"b\":{\"raw\":4,\"b\":5}}", nested, 0);
+	TEST_EXCLUDING("[0,2,[1]]", "[0,1,2,[1]]", index, 0);
+	TEST_EXCLUDING("null", "[0,1,2]", root, 0);
+	TEST_EXCLUDING("[{\"y\":1}]", "[{\"y\":1}]", none, 0);
+
+	/* ȱʡʱֵҲҪϷ */
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parse_excluding(&v, "{\"debug\":[1,tru],\"a\":1}", paths, 1, 0));
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_excluding(&v, "{\"debug\":[1,tru],\"a\":1}", paths, 1, LEPT_PARSE_SKIP_UNCHECKED));
+	EXPECT_EQ_SIZE_T(1, lept_get_object_size(&v));
+	lept_free(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, lept_parse_excluding(&v, "{\"debug\":{\"a\":1 \"b\":2}}", paths, 1, 0));
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_QUOTATION_MARK, lept_parse_excluding(&v, "{\"debug\":\"abc", paths, 1, LEPT_PARSE_SKIP_UNCHECKED));
+	EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_parse_excluding(&v, "{\"debug\":1} x", paths, 1, 0));
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+
+	/* Ϸ· */
+	v.type = LEPT_FALSE;
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_POINTER, lept_parse_excluding(&v, "{\"a\":1}", bad, 2, 0));
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_POINTER, lept_parse_excluding(&v, "{\"a\":1}", bad + 2, 1, 0));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_POINTER, lept_parse_excluding(&v, "{\"a\":1}", bad + 3, 1, 0));
+}
+
+#define TEST_PROJECTED(expect, json, paths)\
+	do {\
+		lept_value v;\
+		char* json2;\
+		size_t length;\
+		lept_init(&v);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_projected(&v, json, sizeof(json) - 1, paths, sizeof(paths) / sizeof(paths[0])));\
+		json2 = lept_stringify(&v, &length);\
+		EXPECT_EQ_STRING(expect, json2, length);\
+		lept_free(&v);\
+		free(json2);\
+	} while (0)
+
+static void test_parse_projected() {
+	static const char json[] = "{\"id\":7,\"user\":{\"name\":\"a\",\"tags\":[1,2],\"addr\":{\"city\":\"x\",\"zip\":1}},"
+		"\"events\":[{\"t\":1,\"u\":{\"id\":1}},{\"t\":2,\"u\":{\"id\":2}},5],\"big\":[[1,2],[3]],\"raw\":\"zzz\"}";
+	static const char* const paths[] = { "/id", "/user/addr/city", "/events/*/u/id", "/big/1" };
+	static const char* const subtree[] = { "/user/addr", "/user/addr/city" };
+	static const char* const root[] = { "" };
+	static const char* const missing[] = { "/missing" };
+	static const char* const bad[] = { "/id", "/user/~" };
+	lept_value v;
+
+	TEST_PROJECTED("{\"id\":7,\"user\":{\"addr\":{\"city\":\"x\"}},\"events\":[{\"u\":{\"id\":1}},{\"u\":{\"id\":2}}],\"big\":[[3]]}", json, paths);
+	TEST_PROJECTED("{\"user\":{\"addr\":{\"city\":\"x\",\"zip\":1}}}", json, subtree);
+	TEST_PROJECTED("[1,{\"a\":2}]", "[1,{\"a\":2}]", root);
+	TEST_PROJECTED("{}", json, missing);
+	TEST_PROJECTED("5", "5", missing);
+
+	/* ֵҲҪϷ */
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parse_projected(&v, "{\"raw\":[tru],\"id\":1}", 20, paths, 1));
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, lept_parse_projected(&v, "{\"id\":1 \"raw\":2}", 16, paths, 1));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_projected(&v, "{\"raw\":[true],\"id\":1}", 21, paths, 1));
+	EXPECT_EQ_SIZE_T(1, lept_get_object_size(&v));
+	EXPECT_EQ_DOUBLE(1.0, lept_get_number(lept_find_object_value(&v, "id", 2)));
+	lept_free(&v);
+
+	/* Ϸ· */
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_POINTER, lept_parse_projected(&v, json, sizeof(json) - 1, bad, 2));
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+}
+
+typedef struct {
+	char buffer[256];
+	size_t length;
+	int limit;		/* ƥôֹͣ0 ʾֹͣ */
+} jsonpath_matches;
+
+static int jsonpath_collect(void* ud, lept_value* v) {
+	/* ƥֵ JSON ';' ָ */
+	jsonpath_matches* m = (jsonpath_matches*)ud;
+	size_t length;
+	char* json = lept_stringify(v, &length);
+	if (m->length + length + 1 < sizeof(m->buffer)) {
+		memcpy(m->buffer + m->length, json, length);
+		m->length += length;
+		m->buffer[m->length++] = ';';
+	}
+	free(json);
+	return m->limit > 0 && --m->limit == 0;
+}
+
+#define TEST_JSONPATH(expect, json, path)\
+	do {\
+		lept_jsonpath* p = lept_jsonpath_compile(path);\
+		jsonpath_matches m;\
+		m.length = 0;\
+		m.limit = 0;\
+		EXPECT_TRUE(p != NULL);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_jsonpath_eval(p, json, sizeof(json) - 1, jsonpath_collect, &m));\
+		EXPECT_EQ_STRING(expect, m.buffer, m.length);\
+		lept_jsonpath_free(p);\
+	} while (0)
+
+#define TEST_JSONPATH_ERROR(error, json, path)\
+	do {\
+		lept_jsonpath* p = lept_jsonpath_compile(path);\
+		jsonpath_matches m;\
+		m.length = 0;\
+		m.limit = 0;\
+		EXPECT_EQ_INT(error, lept_jsonpath_eval(p, json, sizeof(json) - 1, jsonpath_collect, &m));\
+		lept_jsonpath_free(p);\
+	} while (0)
+
+static void test_parse_jsonpath() {
+	static const char json[] = "{\"events\":[{\"user\":{\"id\":1,\"name\":\"x\"}},{\"user\":{\"id\":2}},{\"other\":[1]}],"
+		"\"store\":{\"book\":[{\"a\":1},{\"a\":2},{\"a\":3},{\"a\":4}],\"a\":{\"a\":5}},\"k.l\":\"\\u00e9\"}";
+	lept_jsonpath* p;
+	jsonpath_matches m;
+
+	TEST_JSONPATH("1;2;", json, "$.events[*].user.id");
+	TEST_JSONPATH("1;2;", json, "$..id");
+	TEST_JSONPATH("{\"user\":{\"id\":2}};", json, "$['events'][1]");
+	TEST_JSONPATH("2;3;", json, "$.store.book[1:3].a");
+	TEST_JSONPATH("1;3;", json, "$.store.book[::2].a");
+	TEST_JSONPATH("3;4;", json, "$.store.book[2:].a");
+	TEST_JSONPATH("1;2;3;4;{\"a\":5};5;", json, "$..a");
+	TEST_JSONPATH("\"\xC3\xA9\";", json, "$[\"k.l\"]");
+	TEST_JSONPATH("[1];", json, "$.events..other");
+	TEST_JSONPATH("1;", json, "$.events[2].other[*]");
+	TEST_JSONPATH("", json, "$.missing");
+	TEST_JSONPATH("", json, "$.events.user");
+	TEST_JSONPATH("[1,2];", "[1,2]", "$");
+	TEST_JSONPATH("1;2;", " [1,2] ", "$.*");
+
+	EXPECT_TRUE(lept_jsonpath_compile("events") == NULL);
+	EXPECT_TRUE(lept_jsonpath_compile("$.") == NULL);
+	EXPECT_TRUE(lept_jsonpath_compile("$[-1]") == NULL);
+	EXPECT_TRUE(lept_jsonpath_compile("$[1:2:0]") == NULL);
+	EXPECT_TRUE(lept_jsonpath_compile("$['a") == NULL);
+	EXPECT_TRUE(lept_jsonpath_compile("$[1") == NULL);
+
+	/* صط 0 ʱֹ֮ͣݲټ */
+	p = lept_jsonpath_compile("$[*]");
+	m.length = 0;
+	m.limit = 2;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_jsonpath_eval(p, "[1,2,3,tru", 10, jsonpath_collect, &m));
+	EXPECT_EQ_STRING("1;2;", m.buffer, m.length);
+	lept_jsonpath_free(p);
+
+	/* ֵҲҪϷ */
+	TEST_JSONPATH_ERROR(LEPT_PARSE_INVALID_VALUE, "{\"a\":1,\"b\":[tru]}", "$.a");
+	TEST_JSONPATH_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1 \"b\":2}", "$.a");
+	TEST_JSONPATH_ERROR(LEPT_PARSE_MISS_COLON, "{\"x\":{\"a\" 1}}", "$..a");
+	TEST_JSONPATH_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "{\"a\":1} x", "$.a");
+	TEST_JSONPATH_ERROR(LEPT_PARSE_EXPECT_VALUE, "  ", "$.a");
+}
+
 static void test_parse() {
 	test_parse_null();
 	test_parse_true();
@@ -371,6 +648,12 @@ static void test_parse() {
 	test_parse_miss_key();
 	test_parse_miss_colon();
 	test_parse_miss_comma_or_curly_bracket();
+	test_parse_invalid_utf8();
+	test_parse_error_position();
+	test_skip_value();
+	test_parse_excluding();
+	test_parse_projected();
+	test_parse_jsonpath();
 }
 
 /*	һ JSON Ȼһ JSONַȽ JSON Ƿһģһ
@@ -385,6 +668,8 @@ static void test_parse() {
 		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
 		json2 = lept_stringify(&v, &length);\
 		EXPECT_EQ_STRING(json, json2, length);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify(json, sizeof(json) - 1, json2, &length));\
+		EXPECT_EQ_STRING(json, json2, length);\
 		lept_free(&v);\
 		free(json2);\
 	} while (0)
@@ -400,24 +685,96 @@ static void test_stringify_number() {
 	TEST_ROUNDTRIP("1e+20");
 	TEST_ROUNDTRIP("1.234e+20");
 	TEST_ROUNDTRIP("1.234e-20");
+	TEST_ROUNDTRIP("0.1");
+	TEST_ROUNDTRIP("0.0001");
+	TEST_ROUNDTRIP("1e-05");
+	TEST_ROUNDTRIP("123.456");
+	TEST_ROUNDTRIP("9007199254740991");
+	TEST_ROUNDTRIP("10000000000000000");
+	TEST_ROUNDTRIP("1e+17");
 
 	TEST_ROUNDTRIP("1.0000000000000002"); /* the smallest number > 1 */
-	TEST_ROUNDTRIP("4.9406564584124654e-324"); /* minimum denormal */
-	TEST_ROUNDTRIP("-4.9406564584124654e-324");
-	TEST_ROUNDTRIP("2.2250738585072009e-308");  /* Max subnormal double */
-	TEST_ROUNDTRIP("-2.2250738585072009e-308");
+	TEST_ROUNDTRIP("5e-324"); /* minimum denormal */
+	TEST_ROUNDTRIP("-5e-324");
+	TEST_ROUNDTRIP("2.225073858507201e-308");  /* Max subnormal double */
+	TEST_ROUNDTRIP("-2.225073858507201e-308");
 	TEST_ROUNDTRIP("2.2250738585072014e-308");  /* Min normal positive double */
 	TEST_ROUNDTRIP("-2.2250738585072014e-308");
 	TEST_ROUNDTRIP("1.7976931348623157e+308");  /* Max double */
 	TEST_ROUNDTRIP("-1.7976931348623157e+308");
 }
 
+static void test_stringify_string_escape() {
+	/* ҪתַڳַÿλãԽ 16 ֽڵĿ飩 */
+	static const char escaped[] = { '"', '\\', '\n', 0x01, 0x1F };
+	static const char* expect[] = { "\\\"", "\\\\", "\\n", "\\u0001", "\\u001F" };
+	char s[40], json[60];
+	char* out;
+	lept_value v;
+	size_t i, j, length, n;
+
+	for (j = 0; j < sizeof(escaped); j++) {
+		for (i = 0; i < sizeof(s); i++) {
+			memset(s, 0x80 + (int)j, sizeof(s));
+			s[i] = escaped[j];
+			n = strlen(expect[j]);
+			json[0] = '"';
+			memset(json + 1, 0x80 + (int)j, sizeof(s) - 1 + n);
+			memcpy(json + 1 + i, expect[j], n);
+			json[sizeof(s) + n] = '"';
+			lept_init(&v);
+			lept_set_string(&v, s, sizeof(s));
+			out = lept_stringify(&v, &length);
+			EXPECT_EQ_SIZE_T(sizeof(s) + n + 1, length);
+			EXPECT_TRUE(memcmp(json, out, length) == 0);
+			free(out);
+			lept_free(&v);
+		}
+	}
+}
+
+static void test_stringify_string_reset() {
+	/* ʱµġת塱־޸ַܼʹ */
+	lept_value v, c;
+	char* out;
+	size_t length;
+	lept_init(&v);
+	lept_init(&c);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "\"abc\""));
+	out = lept_stringify(&v, &length);
+	EXPECT_EQ_STRING("\"abc\"", out, length);
+	free(out);
+	lept_set_string(&v, "a\"b", 3);
+	out = lept_stringify(&v, &length);
+	EXPECT_EQ_STRING("\"a\\\"b\"", out, length);
+	free(out);
+	lept_copy(&c, &v);
+	out = lept_stringify(&c, &length);
+	EXPECT_EQ_STRING("\"a\\\"b\"", out, length);
+	free(out);
+	lept_set_string(&v, "abc", 3);
+	out = lept_stringify(&v, &length);
+	EXPECT_EQ_STRING("\"abc\"", out, length);
+	free(out);
+	lept_free(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"a\\u0041\":\"\\u0042\",\"q\\\"\":\"\\t\"}"));
+	out = lept_stringify(&v, &length);
+	EXPECT_EQ_STRING("{\"aA\":\"B\",\"q\\\"\":\"\\t\"}", out, length);
+	free(out);
+	lept_free(&v);
+	lept_free(&c);
+}
+
 static void test_stringify_string() {
 	TEST_ROUNDTRIP("\"\"");
 	TEST_ROUNDTRIP("\"Hello\"");
 	TEST_ROUNDTRIP("\"Hello\\nWorld\"");
 	TEST_ROUNDTRIP("\"\\\" \\\\ / \\b \\f \\n \\r \\t\"");
 	TEST_ROUNDTRIP("\"Hello\\u0000World\"");
+	TEST_ROUNDTRIP("\"0123456789abcdef0123456789abcdef\\n0123456789abcdef\\u001F\\\"\"");
+	TEST_ROUNDTRIP("\"\xE4\xB8\xAD\xE6\x96\x87\xE4\xB8\xAD\xE6\x96\x87\xE4\xB8\xAD\xE6\x96\x87\\t\xF0\x9D\x84\x9E\"");
+	test_stringify_string_escape();
+	test_stringify_string_reset();
 }
 
 static void test_stringify_array() {
@@ -430,6 +787,416 @@ static void test_stringify_object() {
 	TEST_ROUNDTRIP("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
 }
 
+typedef struct {
+	char* buf;
+	size_t len;
+	size_t calls;
+	size_t fail_at;  /* ڼεʱش0 ʾ */
+}test_writer;
+
+static int test_write(void* ud, const char* data, size_t len) {
+	test_writer* w = (test_writer*)ud;
+	if (++w->calls == w->fail_at) {
+		return 42;
+	}
+	w->buf = (char*)realloc(w->buf, w->len + len);
+	memcpy(w->buf + w->len, data, len);
+	w->len += len;
+	return 0;
+}
+
+static void test_stringify_to() {
+	lept_value v;
+	test_writer w;
+	char* out;
+	char line[100];
+	size_t i, length, sizes[3];
+	FILE* f;
+
+	lept_init(&v);
+	lept_set_array(&v, 0);
+	for (i = 0; i < 200; i++) {
+		lept_set_number(lept_pushback_array_element(&v), i * 1.5);
+		lept_set_string(lept_pushback_array_element(&v), "0123456789abcdef0123456789abcdef0123456789\n", 43);
+	}
+	out = lept_stringify(&v, &length);
+	sizes[0] = 0;
+	sizes[1] = 1;
+	sizes[2] = 100;
+	for (i = 0; i < 3; i++) {
+		memset(&w, 0, sizeof(w));
+		EXPECT_EQ_INT(0, lept_stringify_to(&v, test_write, &w, sizes[i]));
+		EXPECT_EQ_SIZE_T(length, w.len);
+		EXPECT_TRUE(memcmp(out, w.buf, length) == 0);
+		if (sizes[i] != 0)
+			EXPECT_TRUE(w.calls > 1);
+		free(w.buf);
+	}
+
+	/* صֹͣ */
+	memset(&w, 0, sizeof(w));
+	w.fail_at = 3;
+	EXPECT_EQ_INT(42, lept_stringify_to(&v, test_write, &w, 64));
+	EXPECT_EQ_SIZE_T(3, w.calls);
+	free(w.buf);
+	free(out);
+
+	if ((f = tmpfile()) != NULL) {
+		lept_set_string(lept_pushback_array_element(&v), "\"", 1);
+		lept_erase_array_element(&v, 0, 399);
+		EXPECT_EQ_INT(0, lept_stringify_to(&v, lept_write_file, f, 0));
+		rewind(f);
+		EXPECT_TRUE(fgets(line, sizeof(line), f) != NULL);
+		EXPECT_EQ_STRING("[\"0123456789abcdef0123456789abcdef0123456789\\n\",\"\\\"\"]", line, strlen(line));
+		fclose(f);
+	}
+	lept_free(&v);
+}
+
+static void test_writer_api() {
+	static const char json[] = "{\"id\":7,\"name\":\"a\\nb\",\"tags\":[true,false,null,[],{}],\"v\":[1.5,\"x\"]}";
+	lept_writer* w;
+	lept_value v;
+	test_writer sink;
+	char* out;
+	size_t length;
+
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[1.5,\"x\"]"));
+	w = lept_writer_create(NULL, NULL, 0);
+	lept_writer_begin_object(w);
+	lept_writer_key(w, "id", 2);
+	lept_writer_number(w, 7.0);
+	lept_writer_key(w, "name", 4);
+	lept_writer_string(w, "a\nb", 3);
+	lept_writer_key(w, "tags", 4);
+	lept_writer_begin_array(w);
+	lept_writer_boolean(w, 1);
+	lept_writer_boolean(w, 0);
+	lept_writer_null(w);
+	lept_writer_begin_array(w);
+	lept_writer_end_array(w);
+	lept_writer_begin_object(w);
+	lept_writer_end_object(w);
+	lept_writer_end_array(w);
+	lept_writer_key(w, "v", 1);
+	lept_writer_value(w, &v);
+	lept_writer_end_object(w);
+	EXPECT_EQ_INT(0, lept_writer_finish(w, &out, &length));
+	EXPECT_EQ_STRING(json, out, length);
+	free(out);
+
+	/* дصСΪ 64 ֽڣֶνص */
+	sink.buf = NULL;
+	sink.len = 0;
+	sink.calls = 0;
+	sink.fail_at = 0;
+	w = lept_writer_create(test_write, &sink, 1);
+	lept_writer_begin_array(w);
+	for (length = 0; length < 100; length++) {
+		lept_writer_value(w, &v);
+	}
+	lept_writer_end_array(w);
+	out = (char*)json;  /* ȷϻᱻΪ NULL */
+	EXPECT_EQ_INT(0, lept_writer_finish(w, &out, &length));
+	EXPECT_TRUE(out == NULL);
+	EXPECT_EQ_SIZE_T(0, length);
+	EXPECT_EQ_SIZE_T(2 + 100 * 10 - 1, sink.len);
+	EXPECT_TRUE(sink.calls > 1);
+	free(sink.buf);
+	lept_free(&v);
+
+	w = lept_writer_create(NULL, NULL, 0);
+	lept_writer_string(w, NULL, 0);
+	EXPECT_EQ_INT(0, lept_writer_finish(w, &out, &length));
+	EXPECT_EQ_STRING("\"\"", out, length);
+	free(out);
+}
+
+static void test_stringify_into() {
+	static const char json[] = "{\"n\":null,\"s\":\"0123456789abcdef0123456789abcdef0123456789abcdef\\t\",\"a\":[1.5,2,3,\"\\u0001\"],\"o\":{\"k\":true}}";
+	lept_value v;
+	char buf[sizeof(json) + 16];
+	size_t i, length = sizeof(json) - 1;
+
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+	EXPECT_EQ_SIZE_T(length, lept_stringify_size(&v));
+	EXPECT_EQ_SIZE_T(length, lept_stringify_into(&v, NULL, 0));
+	/* ÿȣŵʱ '\0'ȷҲԽ */
+	for (i = 0; i <= length + 1; i++) {
+		memset(buf, 'x', sizeof(buf));
+		EXPECT_EQ_SIZE_T(length, lept_stringify_into(&v, buf, i));
+		if (i > length) {
+			EXPECT_EQ_STRING(json, buf, strlen(buf));
+		}
+		EXPECT_TRUE(buf[i] == 'x');
+	}
+	lept_free(&v);
+}
+
+static void test_minify() {
+	static const char json[] = " { \"a\" : [ 1 , [ ] , { } , [ true , { \"b\" : null } ] ] ,\n\t\"c\" : \"x\\u00e9\\/\" , \"d\" : 1.50E+3 } ";
+	static const char compact[] = "{\"a\":[1,[],{},[true,{\"b\":null}]],\"c\":\"x\\u00e9\\/\",\"d\":1.50E+3}";
+	lept_stringify_options opts;
+	char out[sizeof(json)];
+	char* pretty, * deep;
+	size_t i, length;
+
+	/* ʷԪԭֻȥհ */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify(json, sizeof(json) - 1, out, &length));
+	EXPECT_EQ_STRING(compact, out, length);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_reformat(json, sizeof(json) - 1, NULL, &pretty, &length));
+	EXPECT_EQ_STRING(compact, pretty, length);
+	free(pretty);
+
+	/*  lept_stringify_ex() ͬ */
+	opts.indent = 2;
+	opts.indent_char = ' ';
+	opts.space_after_colon = 1;
+	opts.crlf = 0;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_reformat(json, sizeof(json) - 1, &opts, &pretty, &length));
+	EXPECT_EQ_STRING("{\n  \"a\": [\n    1,\n    [],\n    {},\n    [\n      true,\n      {\n        \"b\": null\n      }\n    ]\n  ],\n"
+		"  \"c\": \"x\\u00e9\\/\",\n  \"d\": 1.50E+3\n}", pretty, length);
+	free(pretty);
+
+	/* ֻ len ڵֽڣ벻 '\0' β */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify("[1,2]3", 5, out, &length));
+	EXPECT_EQ_STRING("[1,2]", out, length);
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_minify("[1,2]", 4, out, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_QUOTATION_MARK, lept_minify("\"abc\"", 4, out, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UNICODE_HEX, lept_minify("\"\\u00411\"", 5, out, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify("1e309", 4, out, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, lept_minify("-1.7976931348623159e308", 23, out, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify("-1.7976931348623157e308", 23, out, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify("0.00000000000000000000000000000000000001e346", 44, out, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, lept_minify("0.0000000000000000000000000000000000001e346", 43, out, NULL));
+
+	/* λ */
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COLON, lept_validate(json, 7, &length));
+	EXPECT_EQ_SIZE_T(7, length);
+	EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, lept_validate(json, 9, &length));
+	EXPECT_EQ_SIZE_T(9, length);
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_ESCAPE, lept_validate("[\"ab\\x\"]", 8, &length));
+	EXPECT_EQ_SIZE_T(5, length);
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_validate("[1, tru]", 8, &length));
+	EXPECT_EQ_SIZE_T(7, length);
+	EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_validate("{}                    x", 23, &length));
+	EXPECT_EQ_SIZE_T(22, length);
+
+	deep = (char*)malloc(2 * 2000);
+	for (i = 0; i < 2000; i++) {
+		deep[i] = '[';
+		deep[2000 + i] = ']';
+	}
+	EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, lept_validate(deep, 2 * 2000, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, lept_reformat(deep, 2 * 2000, NULL, &pretty, NULL));
+	EXPECT_TRUE(pretty == NULL);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_reformat(deep + 1000, 2 * 1000, NULL, &pretty, &length));
+	EXPECT_EQ_SIZE_T(2000, length);
+	free(pretty);
+	free(deep);
+}
+
+static void test_stringify_pretty() {
+	static const char json[] = "{\"a\":[1,[],{},[true,{\"b\":null}]],\"c\":\"x\"}";
+	lept_stringify_options opts;
+	lept_value v;
+	char* out;
+	size_t length;
+
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+	opts.indent = 2;
+	opts.indent_char = ' ';
+	opts.space_after_colon = 1;
+	opts.crlf = 0;
+	out = lept_stringify_ex(&v, &opts, &length);
+	EXPECT_EQ_STRING("{\n  \"a\": [\n    1,\n    [],\n    {},\n    [\n      true,\n      {\n        \"b\": null\n      }\n    ]\n  ],\n  \"c\": \"x\"\n}", out, length);
+	free(out);
+
+	opts.indent = 1;
+	opts.indent_char = '\t';
+	opts.space_after_colon = 0;
+	opts.crlf = 1;
+	out = lept_stringify_ex(&v, &opts, &length);
+	EXPECT_EQ_STRING("{\r\n\t\"a\":[\r\n\t\t1,\r\n\t\t[],\r\n\t\t{},\r\n\t\t[\r\n\t\t\ttrue,\r\n\t\t\t{\r\n\t\t\t\t\"b\":null\r\n\t\t\t}\r\n\t\t]\r\n\t],\r\n\t\"c\":\"x\"\r\n}", out, length);
+	free(out);
+
+	opts.indent = 0;
+	out = lept_stringify_ex(&v, &opts, &length);
+	EXPECT_EQ_STRING(json, out, length);
+	free(out);
+	out = lept_stringify_ex(&v, NULL, &length);
+	EXPECT_EQ_STRING(json, out, length);
+	free(out);
+	lept_free(&v);
+
+	/* Ԥ׼ĳȣpacked ҲҪ */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "[[[1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16]]]", LEPT_PARSE_PACK_ARRAYS, NULL));
+	opts.indent = 50;
+	opts.indent_char = ' ';
+	opts.crlf = 0;
+	out = lept_stringify_ex(&v, &opts, &length);
+	EXPECT_EQ_SIZE_T(6 + 23 + 15 + 16 * 151 + 2 * (51 + 101) + 1, length);
+	EXPECT_TRUE(memcmp(out + length - 55, "]\n                                                  ]\n]", 55) == 0);
+	free(out);
+	lept_free(&v);
+}
+
+static void test_stringify_iovec() {
+	lept_value v;
+	lept_iovec* iov;
+	char* scratch, * out, * joined;
+	char big[600];
+	size_t i, count, length, total = 0;
+	int referenced = 0;
+
+	memset(big, 'a', sizeof(big));
+	lept_init(&v);
+	lept_set_array(&v, 0);
+	lept_set_string(lept_pushback_array_element(&v), big, sizeof(big));
+	big[300] = '\n';  /* βתƬθԱ */
+	lept_set_string(lept_pushback_array_element(&v), big, sizeof(big));
+	lept_set_string(lept_pushback_array_element(&v), "short", 5);
+	lept_set_number(lept_pushback_array_element(&v), 1.5);
+
+	out = lept_stringify(&v, &length);
+	iov = lept_stringify_iovec(&v, &count, &scratch);
+	joined = (char*)malloc(length);
+	for (i = 0; i < count; i++) {
+		EXPECT_TRUE(total + iov[i].len <= length);
+		if (total + iov[i].len <= length)
+			memcpy(joined + total, iov[i].base, iov[i].len);
+		total += iov[i].len;
+		if (iov[i].base == lept_get_string(lept_get_array_element(&v, 0))
+			|| iov[i].base == lept_get_string(lept_get_array_element(&v, 1))
+			|| iov[i].base == lept_get_string(lept_get_array_element(&v, 1)) + 301)
+			referenced++;
+	}
+	EXPECT_EQ_SIZE_T(length, total);
+	EXPECT_TRUE(memcmp(out, joined, length) == 0);
+	EXPECT_EQ_INT(3, referenced);
+	free(joined);
+	free(iov);
+	free(scratch);
+	free(out);
+	lept_free(&v);
+}
+
+#define TEST_CANONICAL(expect, json)\
+	do {\
+		lept_value v;\
+		char* json2;\
+		size_t length;\
+		lept_init(&v);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+		json2 = lept_stringify_canonical(&v, &length);\
+		EXPECT_EQ_STRING(expect, json2, length);\
+		lept_free(&v);\
+		free(json2);\
+	} while(0)
+
+static void test_stringify_canonical() {
+	/* RFC 8785 ʾ UTF-16 Ԫƽַ U+FB33 ֮ǰ */
+	TEST_CANONICAL("{\"\\r\":2,\"1\":4,\"\xc2\x80\":6,\"\xc3\xb6\":7,\"\xe2\x82\xac\":1,\"\xf0\x9f\x98\x80\":5,\"\xef\xac\xb3\":3}",
+		"{\"\\u20ac\":1,\"\\r\":2,\"\\ufb33\":3,\"1\":4,\"\\ud83d\\ude00\":5,\"\\u0080\":6,\"\\u00f6\":7}");
+	TEST_CANONICAL("{\"a\":{\"x\":true,\"y\":null},\"b\":[{\"a\":2,\"z\":1},{}]}",
+		"{ \"b\" : [ { \"z\" : 1, \"a\" : 2 }, {} ], \"a\" : { \"y\" : null, \"x\" : true } }");
+	TEST_CANONICAL("{\"a\":2,\"ab\":1}", "{\"ab\":1,\"a\":2}");
+
+	TEST_CANONICAL("[0,0,1.5,-1.5,1e+21,-1e+21,123000000000000000000,1e-7,0.000001,5e-324,1.7976931348623157e+308]",
+		"[0,-0,1.5,-1.5,1e21,-1e21,123e18,1e-7,1e-6,4.9406564584124654e-324,1.7976931348623157e308]");
+	TEST_CANONICAL("\"\\u001f\\b\\t\\n\\f\\r\\\"\\\\/\xc3\xa9\"", "\"\\u001F\\b\\t\\n\\f\\r\\\"\\\\\\/\\u00e9\"");
+}
+
+static void test_stringify_parallel() {
+	lept_value v, * e;
+	char* expect, * actual;
+	size_t i, length1, length2;
+	unsigned threads;
+	lept_init(&v);
+	lept_set_object(&v, 0);
+	lept_set_string(lept_set_object_value(&v, "name", 4), "records", 7);
+	e = lept_set_object_value(&v, "data", 4);
+	lept_set_array(e, 0);
+	for (i = 0; i < 5000; i++) {
+		lept_value* r = lept_pushback_array_element(e);
+		lept_set_object(r, 0);
+		lept_set_number(lept_set_object_value(r, "id", 2), (double)i);
+		lept_set_string(lept_set_object_value(r, "s", 1), "a\"b", i % 4);
+		lept_set_array(lept_set_object_value(r, "a", 1), 0);
+	}
+	expect = lept_stringify(&v, &length1);
+	for (threads = 0; threads <= 7; threads++) {
+		actual = lept_stringify_parallel(&v, threads, &length2);
+		EXPECT_EQ_SIZE_T(length1, length2);
+		EXPECT_TRUE(length1 == length2 && memcmp(expect, actual, length1 + 1) == 0);
+		free(actual);
+	}
+	free(expect);
+	lept_free(&v);
+}
+
+#define EXPECT_CACHED(v, cache)\
+	do {\
+		size_t length1, length2;\
+		char* expect = lept_stringify(v, &length1);\
+		const char* actual = lept_stringify_cached(v, cache, &length2);\
+		EXPECT_EQ_SIZE_T(length1, length2);\
+		EXPECT_TRUE(length1 == length2 && memcmp(expect, actual, length1 + 1) == 0);\
+		free(expect);\
+	} while(0)
+
+static void test_stringify_cached() {
+	lept_value v, * a, * b, * e;
+	lept_stringify_cache* cache = lept_stringify_cache_create();
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v,
+		"{\"a\":[1,2,{\"x\":\"y\"}],\"b\":{\"c\":[true,false,null],\"d\":\"s\\n\"},"
+		"\"e\":[[1],[2,3],[],{}],\"n\":[0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15]}"));
+	EXPECT_CACHED(&v, cache);
+	EXPECT_CACHED(&v, cache);  /* û޸ģһθ */
+
+	a = lept_find_object_value(&v, "a", 1);
+	lept_set_number(lept_get_array_element(a, 1), 20.0);
+	EXPECT_CACHED(&v, cache);
+	lept_set_string(lept_pushback_array_element(a), "new", 3);
+	EXPECT_CACHED(&v, cache);
+
+	b = lept_find_object_value(&v, "b", 1);
+	lept_set_boolean(lept_set_object_value(b, "f", 1), 1);
+	lept_set_null(lept_set_object_value(b, "d", 1));
+	EXPECT_CACHED(&v, cache);
+	lept_remove_object_value(b, 0);
+	EXPECT_CACHED(&v, cache);
+
+	/* תԿɸƣҪ */
+	e = lept_find_object_value(&v, "e", 1);
+	lept_swap(lept_get_array_element(e, 0), lept_get_array_element(e, 1));
+	EXPECT_CACHED(&v, cache);
+	lept_move(lept_get_array_element(e, 2), lept_get_array_element(e, 0));
+	EXPECT_CACHED(&v, cache);
+	lept_erase_array_element(e, 0, 1);
+	EXPECT_CACHED(&v, cache);
+	lept_splice_array(e, 0, 0, a, 0, 2, 1);
+	EXPECT_CACHED(&v, cache);
+	/* ֡null ҲҪø */
+	lept_copy(lept_get_array_element(lept_find_object_value(&v, "n", 1), 0), lept_get_array_element(lept_find_object_value(&v, "n", 1), 15));
+	EXPECT_CACHED(&v, cache);
+	lept_copy(lept_get_array_element(e, 0), lept_find_object_value(&v, "b", 1));
+	EXPECT_CACHED(&v, cache);
+
+	lept_set_number(lept_get_array_element(lept_find_object_value(&v, "n", 1), 3), -1.0);
+	EXPECT_CACHED(&v, cache);
+	lept_set_number(lept_find_object_value(&v, "a", 1), 1.0);
+	EXPECT_CACHED(&v, cache);
+	lept_free(&v);
+	EXPECT_CACHED(&v, cache);
+
+	lept_stringify_cache_free(cache);
+}
+
 static void test_stringify() {
 	TEST_ROUNDTRIP("null");
 	TEST_ROUNDTRIP("false");
@@ -438,6 +1205,15 @@ static void test_stringify() {
 	test_stringify_string();
 	test_stringify_array();
 	test_stringify_object();
+	test_stringify_to();
+	test_writer_api();
+	test_stringify_into();
+	test_stringify_pretty();
+	test_minify();
+	test_stringify_canonical();
+	test_stringify_parallel();
+	test_stringify_iovec();
+	test_stringify_cached();
 }
 
 #define TEST_EQUAL(json1, json2, equality)\
@@ -631,6 +1407,201 @@ static void test_access_array() {
 	lept_free(&a);
 }
 
+static void test_access_array_segmented() {
+	lept_value a, b;
+	lept_value* first;
+	char* out;
+	size_t i, length;
+
+	lept_init(&a);
+	lept_set_segmented_array(&a, 0);
+	EXPECT_EQ_SIZE_T(0, lept_get_array_size(&a));
+	first = lept_pushback_array_element(&a);
+	lept_set_number(first, 0.0);
+	for (i = 1; i < 1000; i++)
+		lept_set_number(lept_pushback_array_element(&a), (double)i);
+	EXPECT_EQ_SIZE_T(1000, lept_get_array_size(&a));
+	EXPECT_TRUE(lept_get_array_capacity(&a) >= 1000);
+	/* growing never moves existing elements */
+	EXPECT_TRUE(first == lept_get_array_element(&a, 0));
+	for (i = 0; i < 1000; i++)
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+	EXPECT_EQ_DOUBLE(499500.0, lept_get_array_sum(&a));
+
+	/* insert and erase across block boundaries */
+	lept_set_string(lept_insert_array_element(&a, 10), "x", 1);
+	EXPECT_EQ_SIZE_T(1001, lept_get_array_size(&a));
+	EXPECT_EQ_STRING("x", lept_get_string(lept_get_array_element(&a, 10)), lept_get_string_length(lept_get_array_element(&a, 10)));
+	EXPECT_EQ_DOUBLE(9.0, lept_get_number(lept_get_array_element(&a, 9)));
+	EXPECT_EQ_DOUBLE(10.0, lept_get_number(lept_get_array_element(&a, 11)));
+	EXPECT_EQ_DOUBLE(999.0, lept_get_number(lept_get_array_element(&a, 1000)));
+	lept_erase_array_element(&a, 10, 1);
+	lept_erase_array_element(&a, 250, 300);
+	EXPECT_EQ_SIZE_T(700, lept_get_array_size(&a));
+	EXPECT_EQ_DOUBLE(249.0, lept_get_number(lept_get_array_element(&a, 249)));
+	EXPECT_EQ_DOUBLE(550.0, lept_get_number(lept_get_array_element(&a, 250)));
+	EXPECT_EQ_DOUBLE(999.0, lept_get_number(lept_get_array_element(&a, 699)));
+	lept_popback_array_element(&a);
+	EXPECT_EQ_SIZE_T(699, lept_get_array_size(&a));
+
+	/* copy keeps the layout, and equals a generic array with the same elements */
+	lept_init(&b);
+	lept_copy(&b, &a);
+	EXPECT_TRUE(lept_is_equal(&a, &b));
+	lept_free(&b);
+	lept_set_array(&b, 0);
+	for (i = 0; i < lept_get_array_size(&a); i++)
+		lept_copy(lept_pushback_array_element(&b), lept_get_array_element(&a, i));
+	EXPECT_TRUE(lept_is_equal(&a, &b));
+	EXPECT_TRUE(lept_is_equal(&b, &a));
+
+	lept_erase_array_element(&a, 3, lept_get_array_size(&a) - 3);
+	out = lept_stringify(&a, &length);
+	EXPECT_EQ_STRING("[0,1,2]", out, length);
+	free(out);
+	lept_shrink_array(&a);
+	EXPECT_TRUE(lept_get_array_capacity(&a) >= 3);
+	EXPECT_TRUE(lept_get_array_capacity(&a) < 699);
+	lept_clear_array(&a);
+	EXPECT_EQ_SIZE_T(0, lept_get_array_size(&a));
+	lept_free(&a);
+	lept_free(&b);
+}
+
+static void test_access_array_splice() {
+	lept_value a, b;
+	char* out;
+	size_t length;
+
+#define EXPECT_ARRAY_JSON(expect, v)\
+	do {\
+		out = lept_stringify(v, &length);\
+		EXPECT_EQ_STRING(expect, out, length);\
+		free(out);\
+	} while(0)
+
+	lept_init(&a);
+	lept_init(&b);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, "[0,1,2,3]"));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&b, "[\"a\",[\"b\"],{\"c\":null}]"));
+
+	/* copy keeps src intact */
+	lept_splice_array(&a, 1, 2, &b, 0, 2, 0);
+	EXPECT_ARRAY_JSON("[0,\"a\",[\"b\"],3]", &a);
+	EXPECT_EQ_SIZE_T(3, lept_get_array_size(&b));
+
+	/* move transfers the elements out of src */
+	lept_splice_array(&a, lept_get_array_size(&a), 0, &b, 1, 2, 1);
+	EXPECT_ARRAY_JSON("[0,\"a\",[\"b\"],3,[\"b\"],{\"c\":null}]", &a);
+	EXPECT_ARRAY_JSON("[\"a\"]", &b);
+
+	/* self splice: move a range backwards and forwards, then copy onto itself */
+	lept_splice_array(&a, 0, 0, &a, 4, 2, 1);
+	EXPECT_ARRAY_JSON("[[\"b\"],{\"c\":null},0,\"a\",[\"b\"],3]", &a);
+	lept_splice_array(&a, 6, 0, &a, 0, 2, 1);
+	EXPECT_ARRAY_JSON("[0,\"a\",[\"b\"],3,[\"b\"],{\"c\":null}]", &a);
+	lept_splice_array(&a, 0, 4, &a, 0, 6, 0);
+	EXPECT_ARRAY_JSON("[0,\"a\",[\"b\"],3,[\"b\"],{\"c\":null},[\"b\"],{\"c\":null}]", &a);
+
+	/* delete only, and packed sources */
+	lept_splice_array(&a, 1, 7, NULL, 0, 0, 0);
+	EXPECT_ARRAY_JSON("[0]", &a);
+	lept_free(&b);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&b, "[1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16]"));
+	EXPECT_TRUE(lept_pack_array(&b));
+	lept_splice_array(&a, 1, 0, &b, 13, 3, 1);
+	EXPECT_ARRAY_JSON("[0,14,15,16]", &a);
+	EXPECT_EQ_SIZE_T(13, lept_get_array_size(&b));
+	EXPECT_TRUE(lept_get_array_doubles(&b) != NULL);
+
+	/* segmented destination */
+	lept_set_segmented_array(&b, 0);
+	lept_splice_array(&b, 0, 0, &a, 0, 4, 0);
+	lept_splice_array(&b, 2, 1, &a, 0, 4, 1);
+	EXPECT_ARRAY_JSON("[0,14,0,14,15,16,16]", &b);
+	EXPECT_EQ_SIZE_T(0, lept_get_array_size(&a));
+
+#undef EXPECT_ARRAY_JSON
+	lept_free(&a);
+	lept_free(&b);
+}
+
+static void test_access_array_packed() {
+	static const char json[] = "[1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20]";
+	lept_value a, b;
+	const double* d;
+	double buf[3] = { 1.5, -2.0, 0.25 };
+	char* out;
+	size_t i, length;
+
+	lept_init(&a);
+	lept_init(&b);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&a, json, LEPT_PARSE_PACK_ARRAYS, NULL));
+	EXPECT_EQ_SIZE_T(20, lept_get_array_size(&a));
+#if !defined(LEPT_PACKED_ARRAY_MIN) || LEPT_PACKED_ARRAY_MIN > 0
+	EXPECT_TRUE(lept_get_array_doubles(&a) != NULL);
+	/* only packed on request */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&b, json));
+	EXPECT_TRUE(lept_get_array_doubles(&b) == NULL);
+	lept_free(&b);
+#endif
+	EXPECT_TRUE(lept_pack_array(&a));
+	d = lept_get_array_doubles(&a);
+	EXPECT_TRUE(d != NULL);
+	for (i = 0; i < 20; i++)
+		EXPECT_EQ_DOUBLE(i + 1.0, d[i]);
+	EXPECT_EQ_DOUBLE(210.0, lept_get_array_sum(&a));
+	EXPECT_EQ_DOUBLE(1.0, lept_get_array_min(&a));
+	EXPECT_EQ_DOUBLE(20.0, lept_get_array_max(&a));
+	out = lept_stringify(&a, &length);
+	EXPECT_EQ_STRING(json, out, length);
+	free(out);
+
+	lept_copy(&b, &a);
+	EXPECT_TRUE(lept_get_array_doubles(&b) != NULL);
+	EXPECT_TRUE(lept_is_equal(&a, &b));
+
+	/* erase and popback keep the packed storage */
+	lept_erase_array_element(&a, 0, 2);
+	lept_popback_array_element(&a);
+	EXPECT_EQ_SIZE_T(17, lept_get_array_size(&a));
+	EXPECT_TRUE(lept_get_array_doubles(&a) != NULL);
+	EXPECT_EQ_DOUBLE(3.0, lept_get_array_min(&a));
+	EXPECT_EQ_DOUBLE(19.0, lept_get_array_max(&a));
+
+	/* reading by value keeps the packed storage, element pointers need an explicit unpack */
+	d = lept_get_array_doubles(&a);
+	EXPECT_EQ_DOUBLE(3.0, lept_get_array_number(&a, 0));
+	EXPECT_EQ_DOUBLE(19.0, lept_get_array_number(&a, 16));
+	EXPECT_TRUE(lept_get_array_doubles(&a) == d);
+	lept_unpack_array(&a);
+	EXPECT_TRUE(lept_get_array_doubles(&a) == NULL);
+	EXPECT_EQ_DOUBLE(3.0, lept_get_number(lept_get_array_element(&a, 0)));
+	EXPECT_EQ_DOUBLE(19.0, lept_get_array_number(&a, 16));
+	EXPECT_EQ_DOUBLE(187.0, lept_get_array_sum(&a));
+	lept_set_string(lept_pushback_array_element(&b), "x", 1);
+	EXPECT_EQ_SIZE_T(21, lept_get_array_size(&b));
+	EXPECT_EQ_INT(LEPT_STRING, lept_get_type(lept_get_array_element(&b, 20)));
+	EXPECT_EQ_DOUBLE(20.0, lept_get_number(lept_get_array_element(&b, 19)));
+	EXPECT_FALSE(lept_pack_array(&b));
+	lept_popback_array_element(&b);
+	EXPECT_TRUE(lept_pack_array(&b));
+	EXPECT_EQ_DOUBLE(210.0, lept_get_array_sum(&b));
+
+	/* packed and generic arrays with the same numbers are equal */
+	lept_set_array_doubles(&a, buf, 3);
+	lept_free(&b);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&b, "[1.5,-2,0.25]"));
+	EXPECT_TRUE(lept_get_array_doubles(&b) == NULL);
+	EXPECT_TRUE(lept_is_equal(&a, &b));
+	EXPECT_TRUE(lept_is_equal(&b, &a));
+	EXPECT_EQ_DOUBLE(-0.25, lept_get_array_sum(&a));
+	EXPECT_EQ_DOUBLE(-2.0, lept_get_array_min(&a));
+	EXPECT_EQ_DOUBLE(1.5, lept_get_array_max(&b));
+	lept_free(&a);
+	lept_free(&b);
+}
+
 static void test_access_object() {
 	lept_value o, v, * pv;
 	size_t i, j, index;
@@ -702,13 +1673,314 @@ static void test_access_object() {
 	lept_free(&o);
 }
 
+static void test_access_object_by_key() {
+	lept_value a, * o;
+	lept_key id = lept_key_make("id", 2), name = lept_key_make("name", 4), missing = lept_key_make("age", 3);
+	size_t i;
+
+	lept_init(&a);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, "[{\"id\":0,\"name\":\"a\"},{\"id\":1,\"name\":\"b\"},{\"name\":\"c\",\"id\":2}]"));
+	for (i = 0; i < 3; i++) {
+		o = lept_get_array_element(&a, i);
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_find_object_value_by_key(o, &id)));
+		EXPECT_TRUE('a' + i == lept_get_string(lept_find_object_value_by_key(o, &name))[0]);
+		EXPECT_TRUE(lept_find_object_value_by_key(o, &missing) == NULL);
+	}
+	EXPECT_EQ_SIZE_T(1, id.hint);  /* the last object has "id" at index 1 */
+
+	o = lept_get_array_element(&a, 0);
+	lept_set_number(lept_set_object_value_by_key(o, &missing), 20.0);
+	EXPECT_EQ_SIZE_T(3, lept_get_object_size(o));
+	EXPECT_EQ_SIZE_T(2, lept_find_object_index_by_key(o, &missing));
+	lept_set_number(lept_set_object_value_by_key(o, &id), 10.0);
+	EXPECT_EQ_SIZE_T(3, lept_get_object_size(o));
+	EXPECT_EQ_DOUBLE(10.0, lept_get_number(lept_find_object_value(o, "id", 2)));
+	lept_free(&a);
+}
+
+static void test_access_object_layout() {
+	lept_value o, o2, a;
+	char key[4] = "k00";
+	size_t i;
+
+	/* 40 keys set one by one */
+	lept_init(&o);
+	lept_set_object(&o, 0);
+	for (i = 0; i < 40; i++) {
+		key[1] = (char)('0' + i / 10);
+		key[2] = (char)('0' + i % 10);
+		lept_set_number(lept_set_object_value(&o, key, 3), (double)i);
+	}
+	EXPECT_EQ_SIZE_T(40, lept_get_object_size(&o));
+	for (i = 0; i < 40; i++) {
+		key[1] = (char)('0' + i / 10);
+		key[2] = (char)('0' + i % 10);
+		EXPECT_EQ_SIZE_T(i, lept_find_object_index(&o, key, 3));
+		EXPECT_EQ_STRING("k", lept_get_object_key(&o, i), 1);
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_object_value(&o, i)));
+	}
+
+	/* objects with the same keys compare and copy through the shared layout */
+	lept_init(&a);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, "[{\"a\":1,\"b\":[2],\"c\":{\"d\":3}},{\"a\":1,\"b\":[2],\"c\":{\"d\":3}},{\"a\":1,\"b\":[2]}]"));
+	EXPECT_TRUE(lept_is_equal(lept_get_array_element(&a, 0), lept_get_array_element(&a, 1)));
+	EXPECT_FALSE(lept_is_equal(lept_get_array_element(&a, 0), lept_get_array_element(&a, 2)));
+	lept_set_number(lept_set_object_value(lept_get_array_element(&a, 2), "c", 1), 0.0);
+	EXPECT_FALSE(lept_is_equal(lept_get_array_element(&a, 0), lept_get_array_element(&a, 2)));
+	lept_init(&o2);
+	lept_copy(&o2, lept_get_array_element(&a, 0));
+	EXPECT_TRUE(lept_is_equal(&o2, lept_get_array_element(&a, 1)));
+
+	/* removing a member in the middle keeps order of the rest */
+	lept_remove_object_value(&o2, 1);
+	EXPECT_EQ_SIZE_T(2, lept_get_object_size(&o2));
+	EXPECT_EQ_STRING("a", lept_get_object_key(&o2, 0), lept_get_object_key_length(&o2, 0));
+	EXPECT_EQ_STRING("c", lept_get_object_key(&o2, 1), lept_get_object_key_length(&o2, 1));
+	EXPECT_TRUE(lept_find_object_value(&o2, "b", 1) == NULL);
+	lept_remove_object_value(lept_get_array_element(&a, 1), 2);
+	EXPECT_EQ_SIZE_T(2, lept_get_object_size(lept_get_array_element(&a, 1)));
+	EXPECT_TRUE(lept_find_object_value(lept_get_array_element(&a, 1), "c", 1) == NULL);
+	lept_free(&o2);
+	lept_free(&a);
+
+	/* duplicated keys: lookup finds the first one */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, "{\"x\":1,\"x\":2}"));
+	EXPECT_EQ_SIZE_T(2, lept_get_object_size(&a));
+	EXPECT_EQ_DOUBLE(1.0, lept_get_number(lept_find_object_value(&a, "x", 1)));
+	lept_free(&a);
+
+	/* empty keys */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, "[{\"\":1,\"a\":2},{\"\":3,\"a\":4}]"));
+	EXPECT_EQ_SIZE_T(0, lept_find_object_index(lept_get_array_element(&a, 1), "", 0));
+	EXPECT_EQ_DOUBLE(3.0, lept_get_number(lept_find_object_value(lept_get_array_element(&a, 1), "", 0)));
+	lept_free(&a);
+
+	/* 20 parsed keys: the shape looks keys up by hash */
+	{
+		char json[256] = "{";
+		for (i = 0; i < 20; i++) {
+			sprintf(json + strlen(json), "%s\"k%02u\":%u", i > 0 ? "," : "", (unsigned)i, (unsigned)i);
+		}
+		strcat(json, "}");
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, json));
+		for (i = 0; i < 20; i++) {
+			key[1] = (char)('0' + i / 10);
+			key[2] = (char)('0' + i % 10);
+			EXPECT_EQ_SIZE_T(i, lept_find_object_index(&a, key, 3));
+		}
+		EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(&a, "k20", 3));
+	}
+	lept_free(&a);
+
+	/* objects with distinct keys, like a map keyed by id, stop adding shapes */
+	{
+		char json[1024] = "[";
+		char id[5] = "id00";
+		for (i = 0; i < 40; i++) {
+			sprintf(json + strlen(json), "%s{\"id%02u\":%u}", i > 0 ? "," : "", (unsigned)i, (unsigned)i);
+		}
+		strcat(json, "]");
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, json));
+		for (i = 0; i < 40; i++) {
+			id[2] = (char)('0' + i / 10);
+			id[3] = (char)('0' + i % 10);
+			EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_find_object_value(lept_get_array_element(&a, i), id, 4)));
+		}
+		/* a key with no transition in the tree moves the object to lept_member */
+		lept_set_number(lept_set_object_value(lept_get_array_element(&a, 0), "new", 3), 1.0);
+		EXPECT_EQ_SIZE_T(2, lept_get_object_size(lept_get_array_element(&a, 0)));
+		EXPECT_EQ_SIZE_T(1, lept_find_object_index(lept_get_array_element(&a, 0), "new", 3));
+		lept_init(&o2);
+		lept_copy(&o2, &a);
+		EXPECT_TRUE(lept_is_equal(&o2, &a));
+		lept_free(&a);
+		EXPECT_EQ_DOUBLE(39.0, lept_get_number(lept_find_object_value(lept_get_array_element(&o2, 39), "id39", 4)));
+		lept_free(&o2);
+	}
+
+	/* parsing an object with more keys than a shape can hold */
+	{
+		char* json = lept_stringify(&o, NULL);
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, json));
+		EXPECT_TRUE(lept_is_equal(&a, &o));
+		EXPECT_EQ_DOUBLE(39.0, lept_get_number(lept_find_object_value(&a, "k39", 3)));
+		free(json);
+	}
+	lept_free(&a);
+	lept_free(&o);
+}
+
+static lept_value* pointer_get(const lept_value* v, const char* pointer) {
+	lept_pointer* p = lept_pointer_compile(pointer);
+	lept_value* ret = lept_pointer_get(v, p);
+	lept_pointer_free(p);
+	return ret;
+}
+
+static void test_access_pointer() {
+	static const char json[] = "{\"a\":{\"b\":[10,{\"c\":\"x\"}]},\"m~n\":1,\"x/y\":2,\"\":3,\"p\":[1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16]}";
+	static const char* const batch[] = { "/a/b/0", "/a/b/1/c", "/a/z", "/a/b/1/c", "/m~0n", "" };
+	lept_pointer* p[6];
+	lept_value* out[6];
+	lept_value v, w;
+	size_t i;
+	char* json2;
+	size_t length;
+
+	EXPECT_TRUE(lept_pointer_compile("a") == NULL);
+	EXPECT_TRUE(lept_pointer_compile("/a~2") == NULL);
+	EXPECT_TRUE(lept_pointer_compile("/a~") == NULL);
+
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+	EXPECT_TRUE(pointer_get(&v, "") == &v);
+	EXPECT_EQ_DOUBLE(10.0, lept_get_number(pointer_get(&v, "/a/b/0")));
+	EXPECT_EQ_STRING("x", lept_get_string(pointer_get(&v, "/a/b/1/c")), lept_get_string_length(pointer_get(&v, "/a/b/1/c")));
+	EXPECT_EQ_DOUBLE(1.0, lept_get_number(pointer_get(&v, "/m~0n")));
+	EXPECT_EQ_DOUBLE(2.0, lept_get_number(pointer_get(&v, "/x~1y")));
+	EXPECT_EQ_DOUBLE(3.0, lept_get_number(pointer_get(&v, "/")));
+	EXPECT_EQ_DOUBLE(16.0, lept_get_number(pointer_get(&v, "/p/15")));
+	EXPECT_TRUE(pointer_get(&v, "/a/b/2") == NULL);
+	EXPECT_TRUE(pointer_get(&v, "/a/b/01") == NULL);
+	EXPECT_TRUE(pointer_get(&v, "/a/b/-") == NULL);
+	EXPECT_TRUE(pointer_get(&v, "/a/b/0/z") == NULL);
+
+	/* Ԫû lept_valueget ȡset תͨ洢 */
+	EXPECT_TRUE(lept_pack_array(pointer_get(&v, "/p")));
+	EXPECT_TRUE(pointer_get(&v, "/p/15") == NULL);
+	p[0] = lept_pointer_compile("/p/15");
+	EXPECT_EQ_DOUBLE(16.0, lept_get_number(lept_pointer_set(&v, p[0])));
+	EXPECT_TRUE(lept_get_array_doubles(pointer_get(&v, "/p")) == NULL);
+	lept_pointer_free(p[0]);
+
+	/* ͬһõָ״ͬĶ */
+	lept_init(&w);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&w, "[{\"k\":1,\"id\":5},{\"k\":2,\"id\":6},{\"id\":7}]"));
+	p[0] = lept_pointer_compile("/id");
+	for (i = 0; i < 3; i++)
+		EXPECT_EQ_DOUBLE(5.0 + i, lept_get_number(lept_pointer_get(lept_get_array_element(&w, i), p[0])));
+	lept_pointer_free(p[0]);
+
+	/* ֵ */
+	for (i = 0; i < 6; i++)
+		p[i] = lept_pointer_compile(batch[i]);
+	EXPECT_EQ_SIZE_T(5, lept_pointer_get_batch(&v, p, 6, out));
+	EXPECT_EQ_DOUBLE(10.0, lept_get_number(out[0]));
+	EXPECT_TRUE(out[1] != NULL && out[1] == out[3]);
+	EXPECT_TRUE(out[2] == NULL);
+	EXPECT_EQ_DOUBLE(1.0, lept_get_number(out[4]));
+	EXPECT_TRUE(out[5] == &v);
+	for (i = 0; i < 6; i++)
+		lept_pointer_free(p[i]);
+
+	/* ʱȱٵĳԱ */
+	lept_set_null(&w);
+	p[0] = lept_pointer_compile("/q/r");
+	lept_set_number(lept_pointer_set(&w, p[0]), 1.0);
+	p[1] = lept_pointer_compile("/q/s");
+	lept_set_array(lept_pointer_set(&w, p[1]), 0);
+	p[2] = lept_pointer_compile("/q/s/-");
+	lept_set_boolean(lept_pointer_set(&w, p[2]), 1);
+	p[3] = lept_pointer_compile("/q/s/1");
+	lept_set_string(lept_pointer_set(&w, p[3]), "t", 1);
+	p[4] = lept_pointer_compile("/q/s/0");
+	lept_set_null(lept_pointer_set(&w, p[4]));
+	p[5] = lept_pointer_compile("/q/r/x");
+	EXPECT_TRUE(lept_pointer_set(&w, p[5]) == NULL);
+	json2 = lept_stringify(&w, &length);
+	EXPECT_EQ_STRING("{\"q\":{\"r\":1,\"s\":[null,\"t\"]}}", json2, length);
+	free(json2);
+	for (i = 0; i < 6; i++)
+		lept_pointer_free(p[i]);
+	p[0] = lept_pointer_compile("/q/s/5");
+	EXPECT_TRUE(lept_pointer_set(&w, p[0]) == NULL);
+	lept_pointer_free(p[0]);
+
+	lept_free(&v);
+	lept_free(&w);
+}
+
 static void test_access() {
 	test_access_null();
 	test_access_boolean();
 	test_access_number();
 	test_access_string();
 	test_access_array();
+	test_access_array_packed();
+	test_access_array_segmented();
+	test_access_array_splice();
 	test_access_object();
+	test_access_object_by_key();
+	test_access_object_layout();
+	test_access_pointer();
+}
+
+static void test_simd_level() {
+	static const char special[] = "\"\\\n";
+	static const char space[] = " \t\n\r";
+	char s[72], json[72];
+	double d[40], sum[41], min[41], max[41];
+	lept_value v;
+	char* out;
+	size_t i, k, n, length, offset;
+	int level, used;
+
+	lept_init(&v);
+	for (i = 0; i < 40; i++)
+		d[i] = (double)(i * 7 % 13) * 0.1 - 0.55;
+	for (level = LEPT_SIMD_SCALAR; level <= LEPT_SIMD_AVX2; level++) {
+		used = lept_set_simd_level(level);
+		EXPECT_TRUE(used >= LEPT_SIMD_SCALAR && used <= LEPT_SIMD_AVX2);  /* ʱ̶˼ʱǸü */
+		EXPECT_EQ_INT(used, lept_get_simd_level());
+
+		/* Ҫתַڿڵÿλ */
+		for (i = 0; i < sizeof(s); i++) {
+			for (k = 0; k < 3; k++) {
+				memset(s, 'a', sizeof(s));
+				s[i] = special[k];
+				lept_set_string(&v, s, sizeof(s));
+				out = lept_stringify(&v, &length);
+				EXPECT_EQ_SIZE_T(sizeof(s) + 3, length);
+				EXPECT_TRUE(out[i + 1] == '\\' && out[i + 3] == (i + 1 < sizeof(s) ? 'a' : '"'));
+				free(out);
+			}
+		}
+
+		/* ͬȵĿհ */
+		for (i = 0; i < sizeof(json) - 1; i++) {
+			for (k = 0; k < i; k++)
+				json[k] = space[k % 4];
+			json[i] = 'x';
+			EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_validate(json, i + 1, &offset));
+			EXPECT_EQ_SIZE_T(i, offset);
+		}
+
+		/* ﷨ֵʱųڿڵÿλ */
+		for (i = 1; i < sizeof(json); i++) {
+			memset(json, ' ', sizeof(json));
+			json[0] = '[';
+			json[i] = ']';
+			EXPECT_EQ_INT(LEPT_PARSE_OK, lept_skip_value(json, sizeof(json), 0, &offset));
+			EXPECT_EQ_SIZE_T(i + 1, offset);
+		}
+
+		/* ľۺϽ汾ȫͬ */
+		for (n = 1; n <= 40; n++) {
+			lept_set_array_doubles(&v, d, n);
+			if (level == LEPT_SIMD_SCALAR) {
+				sum[n] = lept_get_array_sum(&v);
+				min[n] = lept_get_array_min(&v);
+				max[n] = lept_get_array_max(&v);
+			}
+			EXPECT_EQ_DOUBLE(sum[n], lept_get_array_sum(&v));
+			EXPECT_EQ_DOUBLE(min[n], lept_get_array_min(&v));
+			EXPECT_EQ_DOUBLE(max[n], lept_get_array_max(&v));
+		}
+	}
+	EXPECT_EQ_DOUBLE(d[0], min[1]);
+	EXPECT_EQ_DOUBLE(d[11], max[40]);  /* 11 * 7 % 13 == 12 */
+	lept_set_simd_level(-1);
+	lept_free(&v);
 }
 
 static void test_copy_move_swap() {
@@ -752,6 +2024,7 @@ int main() {
 	test_move();
 	test_swap();
 	test_access();
+	test_simd_level();
 	printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
 	return main_ret;
 }
\ No newline at end of file